@@ -0,0 +1,106 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <limits>
+
+#include "AssignmentSolver.h"
+
+double AssignmentSolver::solve(const std::vector<double>& costs, size_t rows, size_t columns, std::vector<long>& assignment)
+{
+    assignment.assign(rows, -1);
+    if (rows == 0 || columns == 0) return 0;
+
+    double total = 0;
+    if (rows <= columns) {
+        solveWide(costs.data(), rows, columns);
+        for (size_t column = 1; column <= columns; column++) {
+            size_t row = columnRow[column];
+            if (row == 0) continue;
+            assignment[row - 1] = column - 1;
+            total += costs[(row - 1) * columns + column - 1];
+        }
+    }
+    else {
+        transposed.resize(rows * columns);
+        for (size_t row = 0; row < rows; row++) {
+            for (size_t column = 0; column < columns; column++) {
+                transposed[column * rows + row] = costs[row * columns + column];
+            }
+        }
+        solveWide(transposed.data(), columns, rows);
+        for (size_t row = 1; row <= rows; row++) {
+            size_t column = columnRow[row];
+            if (column == 0) continue;
+            assignment[row - 1] = column - 1;
+            total += costs[(row - 1) * columns + column - 1];
+        }
+    }
+    return total;
+}
+
+/**
+ * Add the rows one by one, each along the shortest augmenting path (Dijkstra on the reduced costs) from a virtual start column.
+ */
+void AssignmentSolver::solveWide(const double* costs, size_t rows, size_t columns)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    rowPotential.assign(rows + 1, 0);
+    columnPotential.assign(columns + 1, 0);
+    columnRow.assign(columns + 1, 0);
+    predecessor.assign(columns + 1, 0);
+
+    for (size_t row = 1; row <= rows; row++) {
+        columnRow[0] = row;
+        size_t column = 0;
+        minSlack.assign(columns + 1, infinity);
+        visited.assign(columns + 1, false);
+        do {
+            visited[column] = true;
+            size_t pathRow = columnRow[column];
+            const double* pathCosts = costs + (pathRow - 1) * columns;
+            double delta = infinity;
+            size_t nextColumn = 0;
+            for (size_t j = 1; j <= columns; j++) {
+                if (visited[j]) continue;
+                double slack = pathCosts[j - 1] - rowPotential[pathRow] - columnPotential[j];
+                if (slack < minSlack[j]) {
+                    minSlack[j] = slack;
+                    predecessor[j] = column;
+                }
+                if (minSlack[j] < delta) {
+                    delta = minSlack[j];
+                    nextColumn = j;
+                }
+            }
+            for (size_t j = 0; j <= columns; j++) {
+                if (visited[j]) {
+                    rowPotential[columnRow[j]] += delta;
+                    columnPotential[j] -= delta;
+                }
+                else {
+                    minSlack[j] -= delta;
+                }
+            }
+            column = nextColumn;
+        } while (columnRow[column] != 0);
+
+        // flip the assignments along the path
+        do {
+            size_t previous = predecessor[column];
+            columnRow[column] = columnRow[previous];
+            column = previous;
+        } while (column != 0);
+    }
+}
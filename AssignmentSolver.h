@@ -0,0 +1,54 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef ASSIGNMENTSOLVER_H_
+#define ASSIGNMENTSOLVER_H_
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * Minimum cost assignment of rows (e.g. replacement requests) to distinct columns (e.g. candidate nodes),
+ * solved with the Hungarian algorithm in its shortest augmenting path form with row and column potentials.
+ * Runtime is O(rows^2 * columns) for rows <= columns, more rows than columns are solved on the transposed matrix.
+ * The scratch space is kept between calls, a solver should be reused.
+ */
+class AssignmentSolver {
+public:
+    /**
+     * @param costs Row-major matrix of rows x columns finite costs
+     * @param assignment Column of each row, resized to rows. -1 for the rows left over when there are more rows than columns.
+     * @return the total cost of the assignment
+     */
+    double solve(const std::vector<double>& costs, size_t rows, size_t columns, std::vector<long>& assignment);
+
+protected:
+    /// Transposed costs, if there are more rows than columns
+    std::vector<double> transposed;
+    std::vector<double> rowPotential;
+    std::vector<double> columnPotential;
+    std::vector<double> minSlack;
+    /// Per column (1-based, 0 is the virtual start column): assigned row (1-based, 0 for none) and predecessor on the augmenting path
+    std::vector<size_t> columnRow;
+    std::vector<size_t> predecessor;
+    std::vector<char> visited;
+
+    /**
+     * Solve for rows <= columns, fills columnRow.
+     */
+    void solveWide(const double* costs, size_t rows, size_t columns);
+};
+
+#endif /* ASSIGNMENTSOLVER_H_ */
@@ -15,6 +15,7 @@
 
 #ifdef WITH_OSG
 #include "ChargingNode.h"
+#include "ChargingNodeRegistry.h"
 
 #include "msgs/ForecastPointInTimeRequest_m.h"
 #include "msgs/ForecastTargetRequest_m.h"
@@ -32,6 +33,8 @@ ChargingNode::ChargingNode()
 
 ChargingNode::~ChargingNode()
 {
+    ChargingNodeRegistry::getInstance().remove(this);
+    cancelAndDelete(chargingUpdateMsg);
 }
 
 void ChargingNode::initialize(int stage)
@@ -46,6 +49,9 @@ void ChargingNode::initialize(int stage)
             this->z = par("posZ");
             this->pitch = 0;
             this->yaw = 0;
+            this->chargingUpdateThreshold = par("chargingUpdateThreshold");
+            this->chargingUpdateMsg = new cMessage("pushChargingUpdate");
+            ChargingNodeRegistry::getInstance().add(this, x, y, z);
             break;
         case 1:
             //Initialize energy storage
@@ -72,6 +78,7 @@ void ChargingNode::initialize(int stage)
             WATCH(chargedPower);
             WATCH(chargedMobileNodes);
             WATCH(reservations);
+            WATCH(chargingUpdates);
             break;
     }
 }
@@ -82,6 +89,7 @@ void ChargingNode::finish()
     recordScalar("chargedPower", chargedPower);
     recordScalar("chargedMobileNodes", chargedMobileNodes);
     recordScalar("reservations", reservations);
+    recordScalar("chargingUpdates", chargingUpdates);
 }
 
 ReplacementData* ChargingNode::endOfOperation()
@@ -104,7 +112,19 @@ void ChargingNode::refreshDisplay() const
 
 void ChargingNode::handleMessage(cMessage* msg)
 {
-    if (msg->isName("startCharge")) {
+    if (msg == chargingUpdateMsg) {
+        pushChargingUpdate();
+    }
+    else if (msg->isName("subscribeChargingUpdates")) {
+        // push the complete state once, only changes afterwards
+        chargingUpdateGate = getOutputGateTo(msg->getSenderModule());
+        pushedChargeStates.clear();
+        scheduleChargingUpdate();
+
+        delete msg;
+        msg = nullptr;
+    }
+    else if (msg->isName("startCharge")) {
         EV_INFO << "MobileNode is ready to get charged" << endl;
         MobileNode *mn = check_and_cast<MobileNode*>(msg->getSenderModule());
         appendToObjectsWaiting(mn, 100.0);
@@ -210,27 +230,7 @@ void ChargingNode::updateState()
     clearChargingSpots();
     fillChargingSpots();
     rearrangeChargingSpots();
-
-    UpdateChargingMsg* updateMsg = new UpdateChargingMsg("chargingUpdate");
-    std::string update("");
-
-    for (auto it = objectsCharging.cbegin(); it != objectsCharging.cend(); ++it) {
-        MobileNode* node = (*it)->getNode();
-        Battery* battery = node->getBattery();
-        update.append(std::to_string(node->getIndex()));
-        update.append(",");
-        update.append(std::to_string(battery->getRemaining()));
-        update.append(",");
-        update.append(std::to_string(battery->getCapacity()));
-        update.append(";");
-    }
-    if (update.empty()) {
-        delete updateMsg;
-    }
-    else {
-        updateMsg->setUpdate(update.c_str());
-        send(updateMsg, "gate$o", 0);
-    }
+    scheduleChargingUpdate();
 }
 
 bool ChargingNode::isCommandCompleted()
@@ -346,6 +346,73 @@ bool ChargingNode::checkForHighestChargedNode(MobileNode* nextNode, MobileNode*
     return false;
 }
 
+/**
+ * Push the charging state to the subscriber at the end of the current simulation instant.
+ * Several updates within the same instant (e.g. an exit followed by the regular update) result in one push.
+ */
+void ChargingNode::scheduleChargingUpdate()
+{
+    if (chargingUpdateGate != nullptr && not chargingUpdateMsg->isScheduled()) {
+        scheduleAt(simTime(), chargingUpdateMsg);
+    }
+}
+
+/**
+ * Send the nodes that changed their spot or whose remaining charge changed by at least chargingUpdateThreshold since the last push.
+ * Nodes that left are forgotten, MissionControl tracks them on their own. Nothing is sent when there is no change.
+ */
+void ChargingNode::pushChargingUpdate()
+{
+    chargingUpdateRecords.clear();
+    currentChargeStates.clear();
+    for (auto it = objectsWaiting.cbegin(); it != objectsWaiting.cend(); ++it) {
+        if (isPhysicallyPresent((*it)->getNode())) {
+            collectChargeState((*it)->getNode(), ChargingSpot::WAITING);
+        }
+    }
+    for (auto it = objectsCharging.cbegin(); it != objectsCharging.cend(); ++it) {
+        collectChargeState((*it)->getNode(), ChargingSpot::CHARGING);
+    }
+    for (auto it = objectsFinished.cbegin(); it != objectsFinished.cend(); ++it) {
+        collectChargeState(*it, ChargingSpot::FINISHED);
+    }
+    pushedChargeStates.swap(currentChargeStates);
+
+    if (not chargingUpdateRecords.empty()) {
+        UpdateChargingMsg* updateMsg = new UpdateChargingMsg("chargingUpdate");
+        updateMsg->setRecordsArraySize(chargingUpdateRecords.size());
+        for (unsigned int i = 0; i < chargingUpdateRecords.size(); i++) {
+            updateMsg->setRecords(i, chargingUpdateRecords[i]);
+        }
+        send(updateMsg, chargingUpdateGate);
+        chargingUpdates++;
+    }
+}
+
+/**
+ * Record the state of the node for the next push and add it to the update records if it differs enough from the last pushed one.
+ * Unchanged nodes keep their last pushed state, so slow charging accumulates until it crosses the threshold.
+ */
+void ChargingNode::collectChargeState(MobileNode* mobileNode, ChargingSpot spot)
+{
+    Battery* battery = mobileNode->getBattery();
+    PushedChargeState state { spot, battery->getRemaining() };
+    auto pushed = pushedChargeStates.find(mobileNode->getIndex());
+    double change = (pushed != pushedChargeStates.end()) ? fabs(state.remaining - pushed->second.remaining) : 0;
+    if (pushed != pushedChargeStates.end() && pushed->second.spot == spot
+            && (change == 0 || change < chargingUpdateThreshold / 100 * battery->getCapacity())) {
+        currentChargeStates[mobileNode->getIndex()] = pushed->second;
+        return;
+    }
+    currentChargeStates[mobileNode->getIndex()] = state;
+
+    ChargingUpdateRecord record;
+    record.nodeIndex = mobileNode->getIndex();
+    record.remaining = battery->getRemaining();
+    record.capacity = battery->getCapacity();
+    chargingUpdateRecords.push_back(record);
+}
+
 /**
  * Removes all connections to the given MobileNode.
  * This needs to be executed before a MobileNode can safely leave the ChargingNode.
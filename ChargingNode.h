@@ -17,6 +17,8 @@
 #define CHARGINGNODE_H_
 
 #include <omnetpp.h>
+#include <unordered_map>
+#include <vector>
 #include "Battery.h"
 #include "ChargeAlgorithmCCCV.h"
 #include "ChargeAlgorithmCCCVCurrent.h"
@@ -44,6 +46,7 @@ private:
     double chargedPower = 0;
     int chargedMobileNodes = 0;
     int reservations = 0;
+    int chargingUpdates = 0;
 protected:
     Battery battery;
     double chargeCurrent;
@@ -56,6 +59,26 @@ protected:
     IChargeAlgorithm* chargeAlgorithm;
     bool active = false;
     bool prioritizeFastCharge;
+
+    /// Spot of a node as pushed to the subscriber of charging updates
+    enum class ChargingSpot {
+        WAITING, CHARGING, FINISHED
+    };
+    struct PushedChargeState {
+        ChargingSpot spot;
+        double remaining;
+    };
+    /// Subscriber of charging updates (MissionControl), nullptr until subscribed
+    cGate *chargingUpdateGate = nullptr;
+    /// Self-message coalescing all updates of one simulation instant into one push
+    cMessage *chargingUpdateMsg = nullptr;
+    /// Change of the remaining charge in [%] of the capacity that is pushed, smaller changes are held back
+    double chargingUpdateThreshold;
+    /// Last pushed state per node index, for all nodes currently at this charging node
+    std::unordered_map<int, PushedChargeState> pushedChargeStates;
+    std::unordered_map<int, PushedChargeState> currentChargeStates;
+    /// Records of the next push, reused
+    std::vector<ChargingUpdateRecord> chargingUpdateRecords;
 public:
     ChargingNode();
     virtual ~ChargingNode();
@@ -118,6 +141,9 @@ protected:
     void rearrangeChargingSpots();
     void chargeAllChargingSpots();
     double getEstimatedWaitingSeconds();
+    void scheduleChargingUpdate();
+    void pushChargingUpdate();
+    void collectChargeState(MobileNode* mobileNode, ChargingSpot spot);
 };
 
 #endif /* CHARGINGNODE_H_ */
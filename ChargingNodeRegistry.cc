@@ -0,0 +1,200 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "ChargingNodeRegistry.h"
+
+/// Lower bound of the grid cell size, in [m]
+#define MIN_CELL_SIZE 1.0
+
+ChargingNodeRegistry& ChargingNodeRegistry::getInstance()
+{
+    static ChargingNodeRegistry registry;
+    return registry;
+}
+
+void ChargingNodeRegistry::add(ChargingNode *cn, double x, double y, double z)
+{
+    remove(cn);
+    entries.push_back(Entry { cn, x, y, z, nextSequence++ });
+    dirty = true;
+    version++;
+}
+
+void ChargingNodeRegistry::remove(ChargingNode *cn)
+{
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->cn == cn) {
+            entries.erase(it);
+            dirty = true;
+            version++;
+            return;
+        }
+    }
+}
+
+/**
+ * Size the cells for about one charging node per cell and sort all nodes into them, in registration order.
+ */
+void ChargingNodeRegistry::rebuildGrid()
+{
+    double maxX = entries.front().x, maxY = entries.front().y;
+    minX = maxX;
+    minY = maxY;
+    for (const Entry& entry : entries) {
+        minX = std::min(minX, entry.x);
+        minY = std::min(minY, entry.y);
+        maxX = std::max(maxX, entry.x);
+        maxY = std::max(maxY, entry.y);
+    }
+    double width = maxX - minX, height = maxY - minY;
+    double area = width * height;
+    cellSize = (area > 0) ? sqrt(area / entries.size()) : std::max(width, height) / entries.size();
+    cellSize = std::max(cellSize, MIN_CELL_SIZE);
+    cellsX = (long) floor(width / cellSize) + 1;
+    cellsY = (long) floor(height / cellSize) + 1;
+
+    cells.assign(cellsX * cellsY, std::vector<size_t>());
+    for (size_t idx = 0; idx < entries.size(); idx++) {
+        long cx = cellOf(entries[idx].x, minX, cellsX);
+        long cy = cellOf(entries[idx].y, minY, cellsY);
+        cells[cy * cellsX + cx].push_back(idx);
+    }
+    dirty = false;
+}
+
+long ChargingNodeRegistry::cellOf(double coordinate, double min, long cells) const
+{
+    double cell = floor((coordinate - min) / cellSize);
+    if (cell < 0) return 0;
+    if (cell >= cells) return cells - 1;
+    return (long) cell;
+}
+
+/**
+ * Keep the k best candidates sorted by key, equal keys by registration order.
+ */
+void ChargingNodeRegistry::insertCandidate(double key, size_t entry, size_t k)
+{
+    auto before = [this](const Candidate& a, const Candidate& b) {
+        return a.key < b.key || (a.key == b.key && entries[a.entry].sequence < entries[b.entry].sequence);
+    };
+    Candidate candidate { key, entry };
+    if (candidates.size() == k && not before(candidate, candidates.back())) {
+        return;
+    }
+    candidates.insert(std::upper_bound(candidates.begin(), candidates.end(), candidate, before), candidate);
+    if (candidates.size() > k) {
+        candidates.pop_back();
+    }
+}
+
+void ChargingNodeRegistry::collectResult(std::vector<ChargingNode *>& result) const
+{
+    result.clear();
+    for (const Candidate& candidate : candidates) {
+        result.push_back(entries[candidate.entry].cn);
+    }
+}
+
+ChargingNode* ChargingNodeRegistry::findNearest(double x, double y, double z)
+{
+    searchNearest(x, y, z, 1);
+    return candidates.empty() ? nullptr : entries[candidates.front().entry].cn;
+}
+
+bool ChargingNodeRegistry::findNearest(double x, double y, double z, ChargingNode *&cn, double& cnX, double& cnY, double& cnZ)
+{
+    searchNearest(x, y, z, 1);
+    if (candidates.empty()) return false;
+    const Entry& entry = entries[candidates.front().entry];
+    cn = entry.cn;
+    cnX = entry.x;
+    cnY = entry.y;
+    cnZ = entry.z;
+    return true;
+}
+
+void ChargingNodeRegistry::findNearest(double x, double y, double z, size_t k, std::vector<ChargingNode *>& result)
+{
+    searchNearest(x, y, z, k);
+    collectResult(result);
+}
+
+/**
+ * Search the grid in square rings around the cell of the position.
+ * All cells of ring r are at least (r - 1) cell sizes away, the search ends once this exceeds the k-th best distance.
+ */
+void ChargingNodeRegistry::searchNearest(double x, double y, double z, size_t k)
+{
+    candidates.clear();
+    if (entries.empty() || k == 0) {
+        return;
+    }
+    if (dirty) rebuildGrid();
+
+    long qx = cellOf(x, minX, cellsX);
+    long qy = cellOf(y, minY, cellsY);
+    long maxRing = std::max(std::max(qx, cellsX - 1 - qx), std::max(qy, cellsY - 1 - qy));
+    for (long r = 0; r <= maxRing; r++) {
+        if (candidates.size() == k && (r - 1) * cellSize > candidates.back().key) {
+            break;
+        }
+        for (long cy = std::max(qy - r, 0L); cy <= std::min(qy + r, cellsY - 1); cy++) {
+            bool fullRow = (cy == qy - r || cy == qy + r);
+            long step = fullRow ? 1 : std::max(2 * r, 1L);
+            for (long cx = qx - r; cx <= qx + r; cx += step) {
+                if (cx < 0 || cx >= cellsX) continue;
+                for (size_t idx : cells[cy * cellsX + cx]) {
+                    const Entry& entry = entries[idx];
+                    insertCandidate(fabs(entry.x - x) + fabs(entry.y - y) + fabs(entry.z - z), idx, k);
+                }
+            }
+        }
+    }
+}
+
+ChargingNode* ChargingNodeRegistry::findLowestEnergy(const EnergyModel& energyModel, double quantileZ, double x, double y, double z)
+{
+    searchLowestEnergy(energyModel, quantileZ, x, y, z, 1);
+    return candidates.empty() ? nullptr : entries[candidates.front().entry].cn;
+}
+
+void ChargingNodeRegistry::findLowestEnergy(const EnergyModel& energyModel, double quantileZ, double x, double y, double z, size_t k,
+        std::vector<ChargingNode *>& result)
+{
+    searchLowestEnergy(energyModel, quantileZ, x, y, z, k);
+    collectResult(result);
+}
+
+void ChargingNodeRegistry::searchLowestEnergy(const EnergyModel& energyModel, double quantileZ, double x, double y, double z, size_t k)
+{
+    candidates.clear();
+    if (entries.empty() || k == 0) {
+        return;
+    }
+
+    batch.clear();
+    batch.reserve(entries.size());
+    for (const Entry& entry : entries) {
+        batch.addMovement(entry.x - x, entry.y - y, entry.z - z);
+    }
+    energyModel.predictLegs(batch, quantileZ, predictions);
+    for (size_t idx = 0; idx < entries.size(); idx++) {
+        insertCandidate(predictions.energyQuantile[idx], idx, k);
+    }
+}
@@ -0,0 +1,121 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef CHARGINGNODEREGISTRY_H_
+#define CHARGINGNODEREGISTRY_H_
+
+#include <vector>
+#include <cstddef>
+
+#include "EnergyModel.h"
+
+class ChargingNode;
+
+/**
+ * Spatial index of all charging nodes of the simulation.
+ * Charging nodes register themselves with their (fixed) position during initialization and unregister on deletion.
+ * Distance queries use a uniform grid over the horizontal plane, rebuilt on the first query after a change.
+ * Distance is the sum of the absolute coordinate differences, ties are resolved in favor of the earlier registered node.
+ */
+class ChargingNodeRegistry {
+public:
+    /**
+     * Shared registry of the simulation.
+     */
+    static ChargingNodeRegistry& getInstance();
+
+    void add(ChargingNode *cn, double x, double y, double z);
+    void remove(ChargingNode *cn);
+    size_t size() const
+    {
+        return entries.size();
+    }
+    /**
+     * @return a counter increased with every change of the registered nodes, to validate results derived from them
+     */
+    long getVersion() const
+    {
+        return version;
+    }
+
+    /**
+     * @return the nearest charging node to the given position, nullptr if none is registered
+     */
+    ChargingNode* findNearest(double x, double y, double z);
+
+    /**
+     * Nearest charging node to the given position together with its registered position.
+     *
+     * @return false if none is registered
+     */
+    bool findNearest(double x, double y, double z, ChargingNode *&cn, double& cnX, double& cnY, double& cnZ);
+
+    /**
+     * The (up to) k nearest charging nodes to the given position, nearest first.
+     */
+    void findNearest(double x, double y, double z, size_t k, std::vector<ChargingNode *>& result);
+
+    /**
+     * @return the charging node needing the least energy (prediction quantile) to fly to from the given position, nullptr if none is registered
+     */
+    ChargingNode* findLowestEnergy(const EnergyModel& energyModel, double quantileZ, double x, double y, double z);
+
+    /**
+     * The (up to) k charging nodes needing the least energy (prediction quantile) to fly to from the given position, lowest first.
+     * Energy is not monotonic in distance (climbs), all nodes are predicted in one batch.
+     */
+    void findLowestEnergy(const EnergyModel& energyModel, double quantileZ, double x, double y, double z, size_t k,
+            std::vector<ChargingNode *>& result);
+
+protected:
+    ChargingNodeRegistry()
+    {
+    }
+
+    struct Entry {
+        ChargingNode *cn;
+        double x, y, z;
+        /// registration order, for tie-breaking
+        long sequence;
+    };
+    /// Candidate of a k-nearest query: distance (or energy) and entry index
+    struct Candidate {
+        double key;
+        size_t entry;
+    };
+
+    std::vector<Entry> entries;
+    long nextSequence = 0;
+    long version = 0;
+
+    /// Grid: entry indices per cell, row-major, valid unless dirty
+    bool dirty = true;
+    double minX = 0, minY = 0, cellSize = 1;
+    long cellsX = 0, cellsY = 0;
+    std::vector<std::vector<size_t>> cells;
+
+    LegBatch batch;
+    LegPredictions predictions;
+    std::vector<Candidate> candidates;
+
+    void rebuildGrid();
+    long cellOf(double coordinate, double min, long cells) const;
+    void searchNearest(double x, double y, double z, size_t k);
+    void searchLowestEnergy(const EnergyModel& energyModel, double quantileZ, double x, double y, double z, size_t k);
+    void insertCandidate(double key, size_t entry, size_t k);
+    void collectResult(std::vector<ChargingNode *>& result) const;
+};
+
+#endif /* CHARGINGNODEREGISTRY_H_ */
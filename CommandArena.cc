@@ -0,0 +1,141 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <algorithm>
+
+#include "CommandArena.h"
+#include "CommandExecEngine.h"
+
+CommandArena::~CommandArena()
+{
+    for (CommandExecEngine *cee : cees) delete cee;
+    for (CommandExecEngine *cee : retainedCEEs) delete cee;
+    for (Command *command : commands) delete command;
+    for (Command *command : retainedCommands) delete command;
+}
+
+void CommandArena::add(Command *command, bool retained)
+{
+    if (retained) {
+        retainedCommands.push_back(command);
+    }
+    else {
+        commands.insert(command);
+    }
+    updatePeak();
+}
+
+void CommandArena::add(CommandExecEngine *cee, bool retained)
+{
+    (retained ? retainedCEEs : cees).push_back(cee);
+    updatePeak();
+}
+
+void CommandArena::updatePeak()
+{
+    peakObjects = std::max(peakObjects, getLiveCommands() + getLiveCEEs());
+}
+
+void CommandArena::adopt(const CommandQueue& commands)
+{
+    for (Command *command : commands) {
+        if (this->commands.count(command) == 0) add(command, false);
+    }
+}
+
+CommandExecEngine* CommandArena::adopt(CommandExecEngine *cee, bool retained)
+{
+    add(cee, retained);
+    return cee;
+}
+
+void CommandArena::release(const CommandQueue& released)
+{
+    for (Command *command : released) {
+        commands.erase(command);
+    }
+}
+
+void CommandArena::discard(const std::vector<CommandExecEngine *>& discarded)
+{
+    inUse.clear();
+    inUse.insert(discarded.begin(), discarded.end());
+    size_t kept = 0;
+    for (CommandExecEngine *cee : retainedCEEs) {
+        if (inUse.count(cee)) {
+            cees.push_back(cee);
+        }
+        else {
+            retainedCEEs[kept++] = cee;
+        }
+    }
+    retainedCEEs.resize(kept);
+
+    inUse.clear();
+    for (CommandExecEngine *cee : discarded) {
+        if (cee != nullptr) inUse.insert(cee->extractCommand());
+    }
+    kept = 0;
+    for (Command *command : retainedCommands) {
+        if (inUse.count(command)) {
+            commands.insert(command);
+        }
+        else {
+            retainedCommands[kept++] = command;
+        }
+    }
+    retainedCommands.resize(kept);
+}
+
+/**
+ * Sweep the CEEs first, the commands in use are the ones of the CEEs kept.
+ */
+void CommandArena::collect(const std::deque<CommandExecEngine *>& queued, const CommandExecEngine *active)
+{
+    inUse.clear();
+    inUse.insert(queued.begin(), queued.end());
+    inUse.insert(active);
+    size_t kept = 0;
+    for (CommandExecEngine *cee : cees) {
+        if (inUse.count(cee)) {
+            cees[kept++] = cee;
+        }
+        else {
+            delete cee;
+            freedObjects++;
+        }
+    }
+    cees.resize(kept);
+
+    inUse.clear();
+    for (CommandExecEngine *cee : cees) inUse.insert(cee->extractCommand());
+    for (CommandExecEngine *cee : retainedCEEs) inUse.insert(cee->extractCommand());
+    for (auto it = commands.begin(); it != commands.end();) {
+        if (inUse.count(*it)) {
+            ++it;
+        }
+        else {
+            delete *it;
+            freedObjects++;
+            it = commands.erase(it);
+        }
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const CommandArena& arena)
+{
+    return os << arena.getLiveCommands() << " commands, " << arena.getLiveCEEs() << " CEEs (peak " << arena.getPeakObjects() << ", freed "
+            << arena.getFreedObjects() << ")";
+}
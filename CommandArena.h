@@ -0,0 +1,131 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef COMMANDARENA_H_
+#define COMMANDARENA_H_
+
+#include <cstddef>
+#include <deque>
+#include <ostream>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "Command.h"
+
+class CommandExecEngine;
+
+/**
+ * Owner of the commands and CEEs of a node.
+ * Objects are created through the arena (or adopted by it) and freed at the reset points of the node, see collect(),
+ * once no longer in use: a CEE if it is neither queued nor active, a command if no kept CEE refers to it.
+ * Retained objects, e.g. the CEEs of a mission program, are kept until the arena is destroyed.
+ * Commands of mission programs are owned by their MissionProgram and never enter the arena.
+ */
+class CommandArena {
+public:
+    CommandArena()
+    {
+    }
+    virtual ~CommandArena();
+    CommandArena(const CommandArena&) = delete;
+    CommandArena& operator=(const CommandArena&) = delete;
+
+    /**
+     * Create a command or CEE, freed by the first collect() it is no longer in use at.
+     */
+    template<typename T, typename ... Args>
+    T* create(Args&&... args)
+    {
+        T *object = new T(std::forward<Args>(args)...);
+        add(object, false);
+        return object;
+    }
+
+    /**
+     * Create a command or CEE kept until the arena is destroyed.
+     */
+    template<typename T, typename ... Args>
+    T* createRetained(Args&&... args)
+    {
+        T *object = new T(std::forward<Args>(args)...);
+        add(object, true);
+        return object;
+    }
+
+    /**
+     * Take ownership of commands created elsewhere, e.g. received with a provisioning mission. Commands already owned are skipped.
+     */
+    void adopt(const CommandQueue& commands);
+
+    /**
+     * Take ownership of a CEE created elsewhere.
+     *
+     * @return the CEE
+     */
+    CommandExecEngine* adopt(CommandExecEngine *cee, bool retained = false);
+
+    /**
+     * Give up ownership of commands without freeing them, e.g. to hand them over to a MissionProgram. Commands not owned are ignored.
+     */
+    void release(const CommandQueue& released);
+
+    /**
+     * Stop retaining the given CEEs and the commands they refer to, freed by the next collect() they are no longer in use at.
+     * Null entries are skipped.
+     */
+    void discard(const std::vector<CommandExecEngine *>& discarded);
+
+    /**
+     * Reset point: free all CEEs that are neither in the given queue nor the active one and all commands no kept CEE refers to.
+     */
+    void collect(const std::deque<CommandExecEngine *>& queued, const CommandExecEngine *active);
+
+    size_t getLiveCommands() const
+    {
+        return commands.size() + retainedCommands.size();
+    }
+    size_t getLiveCEEs() const
+    {
+        return cees.size() + retainedCEEs.size();
+    }
+    size_t getPeakObjects() const
+    {
+        return peakObjects;
+    }
+    long getFreedObjects() const
+    {
+        return freedObjects;
+    }
+
+protected:
+    /// Unordered, so that adopting and releasing a command takes constant time
+    std::unordered_set<Command *> commands;
+    std::vector<CommandExecEngine *> cees;
+    std::vector<Command *> retainedCommands;
+    std::vector<CommandExecEngine *> retainedCEEs;
+    size_t peakObjects = 0;
+    long freedObjects = 0;
+    /// Scratch space of collect() and discard()
+    std::unordered_set<const void *> inUse;
+
+    void add(Command *command, bool retained);
+    void add(CommandExecEngine *cee, bool retained);
+    void updatePeak();
+};
+
+std::ostream& operator<<(std::ostream& os, const CommandArena& arena);
+
+#endif /* COMMANDARENA_H_ */
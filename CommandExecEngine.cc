@@ -41,11 +41,11 @@ bool WaypointCEE::isCommandCompleted()
     return commandCompleted || (distanceSum < 1.e-10);
 }
 
-void WaypointCEE::initializeCEE()
+void WaypointCEE::prepareCEE()
 {
     //absolute distance to next waypoint, in meters
     if (this->command == nullptr) {
-        throw cRuntimeError("initializeCEE(): Command missing.");
+        throw cRuntimeError("prepareCEE(): Command missing.");
     }
     double dx = x1 - x0;
     double dy = y1 - y0;
@@ -62,6 +62,11 @@ void WaypointCEE::initializeCEE()
 
     //update speed based on flight angle
     speed = node->getSpeed(climbAngle);
+}
+
+void WaypointCEE::armCEE()
+{
+    prepareCEE();
 
     // draw probable random value for consumption of this CEE
     consumptionPerSecond = predictNormConsumptionRandom();
@@ -170,13 +175,18 @@ bool TakeoffCEE::isCommandCompleted()
     return (distanceSum < 1.e-10);
 }
 
-void TakeoffCEE::initializeCEE()
+void TakeoffCEE::prepareCEE()
 {
     pitch = 0;
     climbAngle = (z1 > z0) ? 90 : -90;
 
     //update speed based on flight angle
     speed = node->getSpeed(climbAngle);
+}
+
+void TakeoffCEE::armCEE()
+{
+    prepareCEE();
 
     // draw probable value for consumption of this CEE
     consumptionPerSecond = predictNormConsumptionRandom();
@@ -250,7 +260,11 @@ bool HoldPositionCEE::isCommandCompleted()
     return commandCompleted || (simTime() == this->holdPositionTill) ? true : false;
 }
 
-void HoldPositionCEE::initializeCEE()
+void HoldPositionCEE::prepareCEE()
+{
+}
+
+void HoldPositionCEE::armCEE()
 {
     this->holdPositionTill = simTime() + command->getHoldSeconds();
 
@@ -322,7 +336,11 @@ bool ChargeCEE::isCommandCompleted()
     return commandCompleted || (node->battery.isFull());
 }
 
-void ChargeCEE::initializeCEE()
+void ChargeCEE::prepareCEE()
+{
+}
+
+void ChargeCEE::armCEE()
 {
 }
 
@@ -395,7 +413,11 @@ bool ExchangeCEE::isCommandCompleted()
     return commandCompleted;
 }
 
-void ExchangeCEE::initializeCEE()
+void ExchangeCEE::prepareCEE()
+{
+}
+
+void ExchangeCEE::armCEE()
 {
     // draw probable value for consumption of this CEE
     consumptionPerSecond = predictNormConsumptionRandom();
@@ -470,32 +492,33 @@ void ExchangeCEE::performExitActions()
         ChargingNode *cn = UAVNode::findNearestCN(node->getX(), node->getY(), node->getZ());
 
         // Generate WaypointCEE
-        WaypointCommand *goToChargingNodeCommand = new WaypointCommand(cn->getX(), cn->getY(), cn->getZ());
-        WaypointCEE *goToChargingNodeCEE = new WaypointCEE(node, goToChargingNodeCommand);
+        WaypointCommand *goToChargingNodeCommand = node->commandArena.create<WaypointCommand>(cn->getX(), cn->getY(), cn->getZ());
+        WaypointCEE *goToChargingNodeCEE = node->commandArena.create<WaypointCEE>(node, goToChargingNodeCommand);
         goToChargingNodeCEE->setPartOfMission(false);
         goToChargingNodeCEE->setNoReplacementNeeded();
 
-        // Get the duration for the flight to ChargingNode
-        // To get the information the CEE needs to be initialized
-        goToChargingNodeCEE->initializeCEE();
-        double goToChargingNodeDuration = goToChargingNodeCEE->getOverallDuration();
+        // Predict duration and (normalized) consumption of the flight to ChargingNode
+        LegPrediction goToChargingNode = node->getEnergyModel().predictMovement(cn->getX() - node->getX(), cn->getY() - node->getY(),
+                cn->getZ() - node->getZ(), node->getQuantileZ());
+        double goToChargingNodeDuration = goToChargingNode.duration;
+        double goToChargingNodeConsumption = (goToChargingNodeDuration > 0) ? goToChargingNode.energyQuantile / goToChargingNodeDuration : 0;
 
         // Generate and send reservation message to CN
         ReserveSpotMsg *msg = new ReserveSpotMsg("reserveSpot");
         msg->setEstimatedArrival(simTime() + goToChargingNodeDuration);
-        msg->setConsumptionTillArrival(goToChargingNodeCEE->getProbableConsumption());
+        msg->setConsumptionTillArrival(goToChargingNodeConsumption);
         msg->setTargetPercentage(100.0);
         node->send(msg, node->getOutputGateTo(cn));
 
         // Generate ChargeCEE
-        ChargeCommand *chargeCommand = new ChargeCommand(cn);
-        CommandExecEngine *chargeCEE = new ChargeCEE(node, chargeCommand);
+        ChargeCommand *chargeCommand = node->commandArena.create<ChargeCommand>(cn);
+        CommandExecEngine *chargeCEE = node->commandArena.create<ChargeCEE>(node, chargeCommand);
         chargeCEE->setToCoordinates(cn->getX(), cn->getY(), cn->getZ());
         chargeCEE->setPartOfMission(false);
         chargeCEE->setNoReplacementNeeded();
 
-        IdleCommand* idleCommand = new IdleCommand();
-        IdleCEE* idleCEE = new IdleCEE(node, idleCommand);
+        IdleCommand* idleCommand = node->commandArena.create<IdleCommand>();
+        IdleCEE* idleCEE = node->commandArena.create<IdleCEE>(node, idleCommand);
         idleCEE->setToCoordinates(cn->getX(), cn->getY(), cn->getZ());
         idleCEE->setFromCoordinates(cn->getX(), cn->getY(), cn->getZ());
         idleCEE->setPartOfMission(false);
@@ -535,7 +558,11 @@ bool IdleCEE::isCommandCompleted()
     return commandCompleted;
 }
 
-void IdleCEE::initializeCEE()
+void IdleCEE::prepareCEE()
+{
+}
+
+void IdleCEE::armCEE()
 {
     consumptionPerSecond = 0;
 }
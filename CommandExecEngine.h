@@ -139,14 +139,20 @@ public:
     }
 
     /**
-     * Initialize the CEE itself.
-     * The method does not modify the befriended node, see setNodeParameters().
+     * Prepare the CEE for prediction, i.e. derive the movement data (angles, speed) from its coordinates.
+     * Deterministic, does neither modify the befriended node nor draw random numbers.
      */
-    virtual void initializeCEE() = 0;
+    virtual void prepareCEE() = 0;
+
+    /**
+     * Arm the CEE for execution: prepare it and draw its stochastic consumption.
+     * Call this method once, when the CEE is actually executed. The method does not modify the befriended node, see setNodeParameters().
+     */
+    virtual void armCEE() = 0;
 
     /**
      * Transfer CEE parameters to the befriended node.
-     * Call this method (after initializeCEE()) if a CEE should actually be executed by the node.
+     * Call this method (after armCEE()) if a CEE should actually be executed by the node.
      * Do not call if you just want to pre-simulate effects (e.g. consumption) of the CEE.
      */
     virtual void setNodeParameters() = 0;
@@ -358,7 +364,8 @@ protected:
 public:
     WaypointCEE(UAVNode *boundNode, WaypointCommand *command);
     bool isCommandCompleted() override;
-    void initializeCEE() override;
+    void prepareCEE() override;
+    void armCEE() override;
     void setNodeParameters() override;
     void updateState(double stepSize) override;
     double getOverallDuration() const override;
@@ -386,7 +393,8 @@ protected:
 public:
     TakeoffCEE(UAVNode *boundNode, TakeoffCommand *command);
     bool isCommandCompleted() override;
-    void initializeCEE() override;
+    void prepareCEE() override;
+    void armCEE() override;
     void setNodeParameters() override;
     void updateState(double stepSize) override;
     double getOverallDuration() const override;
@@ -413,7 +421,8 @@ protected:
 public:
     HoldPositionCEE(UAVNode *boundNode, HoldPositionCommand *command);
     bool isCommandCompleted() override;
-    void initializeCEE() override;
+    void prepareCEE() override;
+    void armCEE() override;
     void setNodeParameters() override;
     void updateState(double stepSize) override;
     double getOverallDuration() const override;
@@ -438,7 +447,8 @@ protected:
 public:
     ChargeCEE(UAVNode *boundNode, ChargeCommand *command);
     bool isCommandCompleted() override;
-    void initializeCEE() override;
+    void prepareCEE() override;
+    void armCEE() override;
     void setNodeParameters() override;
     void updateState(double stepSize) override;
     double getOverallDuration() const override;
@@ -468,7 +478,8 @@ protected:
 public:
     ExchangeCEE(UAVNode *boundNode, ExchangeCommand *command);
     bool isCommandCompleted() override;
-    void initializeCEE() override;
+    void prepareCEE() override;
+    void armCEE() override;
     void setNodeParameters() override;
     void updateState(double stepSize) override;
     double getOverallDuration() const override;
@@ -502,7 +513,8 @@ protected:
 public:
     IdleCEE(MobileNode *boundNode, IdleCommand *command);
     bool isCommandCompleted() override;
-    void initializeCEE() override;
+    void prepareCEE() override;
+    void armCEE() override;
     void setNodeParameters() override;
     void updateState(double stepSize) override;
     double getOverallDuration() const override;
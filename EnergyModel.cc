@@ -0,0 +1,580 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <sys/types.h>
+#include <omnetpp.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+/// The AVX2 kernel is compiled for the AVX2 target regardless of the build flags and selected at runtime
+#define ENERGYMODEL_AVX2 1
+#define AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+#include "EnergyModel.h"
+#include "UAVSoloEmpiricData.h"
+
+using namespace omnetpp;
+
+/// Legs shorter than this are predicted without consumption, as in UAVNode::getMovementConsumption()
+#define MIN_LEG_DURATION 0.001
+/// Upper bound for the number of lag samples, keeps the sample count within int range
+#define MAX_LAG_SAMPLES 2.e9
+
+constexpr double EnergyModel::DEFAULT_ANGLE_RESOLUTION;
+
+void LegPredictions::resize(size_t count)
+{
+    energyMean.resize(count);
+    energyVariance.resize(count);
+    energyQuantile.resize(count);
+    duration.resize(count);
+    durationQuantile.resize(count);
+    distance.resize(count);
+    row.resize(count);
+    weight.resize(count);
+    cell.resize(count);
+    cellWeight.resize(count);
+}
+
+EnergyModelData EnergyModelData::fromEmpiricData()
+{
+    EnergyModelData data;
+    data.voltage = VOLTAGE;
+    data.lagSamplesPerSecond = LAGS_SAMPLES_PER_SECOND;
+    for (u_int idx = 0; idx < NUM_ANGLES; idx++) {
+        data.angle.push_back(ANGLE2SPEED[idx][0]);
+        data.speedMean.push_back(ANGLE2SPEED[idx][1]);
+        // the measured speed deviation is given in 1/10 [m/s]
+        data.speedStddev.push_back(ANGLE2SPEED[idx][2] / 10);
+        data.power.push_back(ANGLE2POWER[idx][1]);
+        data.lags.push_back(std::vector<double>(ANGLE2LAGS[idx] + 1, ANGLE2LAGS[idx] + 1 + NUM_ANGLELAGS));
+    }
+    data.hoverPower = HOVER_MEAN;
+    data.hoverLags.assign(HOVER_LAGS + 1, HOVER_LAGS + 1 + NUM_HOVERLAGS);
+    return data;
+}
+
+EnergyModelData EnergyModelData::readFile(const std::string& fileName)
+{
+    std::ifstream inputFile(fileName);
+    if (!inputFile.is_open()) {
+        throw cRuntimeError("EnergyModelData::readFile(): Could not open '%s'", fileName.c_str());
+    }
+
+    EnergyModelData data;
+    std::string line;
+    int lineCnt = 0;
+    while (std::getline(inputFile, line)) {
+        lineCnt++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+
+        std::istringstream fields(line);
+        std::string key;
+        if (!(fields >> key)) continue;
+
+        std::vector<double> values;
+        double value;
+        while (fields >> value) {
+            values.push_back(value);
+        }
+        if (!fields.eof()) {
+            throw cRuntimeError("EnergyModelData::readFile(): %s:%d: Unexpected content", fileName.c_str(), lineCnt);
+        }
+
+        if (key == "voltage" && values.size() == 1) {
+            data.voltage = values[0];
+        }
+        else if (key == "lagSamplesPerSecond" && values.size() == 1) {
+            data.lagSamplesPerSecond = (int) values[0];
+        }
+        else if (key == "hover" && values.size() >= 2) {
+            data.hoverPower = values[0];
+            data.hoverLags.assign(values.begin() + 1, values.end());
+        }
+        else if (key == "angle" && values.size() >= 5) {
+            data.angle.push_back(values[0]);
+            data.speedMean.push_back(values[1]);
+            data.speedStddev.push_back(values[2]);
+            data.power.push_back(values[3]);
+            data.lags.push_back(std::vector<double>(values.begin() + 4, values.end()));
+        }
+        else {
+            throw cRuntimeError("EnergyModelData::readFile(): %s:%d: Unknown record '%s' or wrong number of values", fileName.c_str(), lineCnt,
+                    key.c_str());
+        }
+    }
+    data.validate(fileName);
+    return data;
+}
+
+void EnergyModelData::validate(const std::string& origin) const
+{
+    if (voltage <= 0 || lagSamplesPerSecond <= 0) {
+        throw cRuntimeError("EnergyModelData: %s: voltage and lagSamplesPerSecond must be positive", origin.c_str());
+    }
+    if (angle.size() < 2) {
+        throw cRuntimeError("EnergyModelData: %s: at least two angles are required", origin.c_str());
+    }
+    if (speedMean.size() != angle.size() || speedStddev.size() != angle.size() || power.size() != angle.size() || lags.size() != angle.size()) {
+        throw cRuntimeError("EnergyModelData: %s: inconsistent number of angles", origin.c_str());
+    }
+    if (hoverLags.empty()) {
+        throw cRuntimeError("EnergyModelData: %s: hover data missing", origin.c_str());
+    }
+    for (size_t idx = 0; idx < angle.size(); idx++) {
+        if (idx > 0 && angle[idx] <= angle[idx - 1]) {
+            throw cRuntimeError("EnergyModelData: %s: angles must be strictly ascending", origin.c_str());
+        }
+        if (speedMean[idx] <= 0 || speedStddev[idx] < 0 || lags[idx].empty()) {
+            throw cRuntimeError("EnergyModelData: %s: invalid data for angle %f", origin.c_str(), angle[idx]);
+        }
+    }
+}
+
+/**
+ * Flatten the measured data into one row per angle plus two identical hover rows
+ * and pre-interpolate it on the fine angle grid.
+ * Hovering is modeled as a movement with speed 1 m/s, i.e. the hold time is passed as distance.
+ *
+ * @param data Measured data, see EnergyModelData::validate()
+ * @param angleResolution Step of the fine angle grid in [°], has to divide the angle range evenly
+ */
+EnergyModel::EnergyModel(const EnergyModelData& data, double angleResolution)
+{
+    data.validate("EnergyModel");
+    voltage = data.voltage;
+    lagSamplesPerSecond = data.lagSamplesPerSecond;
+    hoverRow = data.angle.size();
+    int rows = hoverRow + 2;
+
+    lagsPerRow = data.hoverLags.size();
+    for (auto it = data.lags.begin(); it != data.lags.end(); ++it) {
+        lagsPerRow = std::max(lagsPerRow, (int) it->size());
+    }
+
+    angles = data.angle;
+    lag0.resize(rows);
+    maxLag.resize(rows);
+    lagSum.resize(rows * lagsPerRow);
+    lagWeightedSum.resize(rows * lagsPerRow);
+
+    // Prefix sums over the PACF lags, see getVariance(). Built from the model data, which may come from a model file,
+    // so they cannot be compile-time tables of the UAVSoloEmpiricData.h measurements.
+    for (int row = 0; row < rows; row++) {
+        const std::vector<double>& lags = (row < hoverRow) ? data.lags[row] : data.hoverLags;
+        lag0[row] = lags[0];
+        maxLag[row] = lags.size() - 1;
+        double sum = 0, weightedSum = 0;
+        for (int h = 0; h < lagsPerRow; h++) {
+            if (h > 0 && h <= maxLag[row]) {
+                sum += lags[h];
+                weightedSum += h * lags[h];
+            }
+            lagSum[row * lagsPerRow + h] = sum;
+            lagWeightedSum[row * lagsPerRow + h] = weightedSum;
+        }
+    }
+
+    this->angleResolution = angleResolution;
+    buildAngleCells(data);
+}
+
+/**
+ * Pre-interpolate speed, power and the variance coefficients of long maneuvers for every step of the fine angle grid.
+ * Measured angles between two steps start a cell of their own, so every cell lies within one measured row.
+ */
+void EnergyModel::buildAngleCells(const EnergyModelData& data)
+{
+    double range = angles.back() - angles.front();
+    if (!(angleResolution > 0) || fabs(round(range / angleResolution) * angleResolution - range) > 1.e-9) {
+        throw cRuntimeError("EnergyModel: angle resolution %g does not divide the angle range of %g degrees", angleResolution, range);
+    }
+    int steps = (int) round(range / angleResolution);
+
+    // cell breakpoints: the grid steps merged with the measured angles, a measured angle replaces a step it coincides with
+    cellAngle.clear();
+    stepCell.resize(steps);
+    size_t next = 1;
+    for (int step = 0; step <= steps; step++) {
+        double angle = (step < steps) ? angles.front() + step * angleResolution : angles.back();
+        while (next < angles.size() && angles[next] < angle - 1.e-9) {
+            cellAngle.push_back(angles[next++]);
+        }
+        if (next < angles.size() && angles[next] <= angle + 1.e-9) {
+            angle = angles[next++];
+        }
+        if (step < steps) stepCell[step] = cellAngle.size();
+        cellAngle.push_back(angle);
+    }
+    hoverCell = cellAngle.size();
+    int cells = hoverCell + 2;
+
+    double mAhPerWh = 1000 / voltage;
+    double varianceScale = mAhPerWh * mAhPerWh / ((double) lagSamplesPerSecond * lagSamplesPerSecond * lagSamplesPerSecond);
+
+    // Once all lags of a row are in use its variance is |samples * (lag0 + 2 * sum) - 2 * weightedSum|,
+    // the absolute value can be dropped if the term is positive from there on
+    std::vector<double> slope(hoverRow + 2), offset(hoverRow + 2);
+    std::vector<int> linearFrom(hoverRow + 2);
+    for (int row = 0; row < hoverRow + 2; row++) {
+        int idx = row * lagsPerRow + maxLag[row];
+        slope[row] = (lag0[row] + 2 * lagSum[idx]) * varianceScale;
+        offset[row] = 2 * lagWeightedSum[idx] * varianceScale;
+        linearFrom[row] = maxLag[row] + 1;
+        if (slope[row] < 0 || slope[row] * linearFrom[row] - offset[row] < 0) {
+            linearFrom[row] = INT_MAX;
+        }
+    }
+
+    cellSpeedMean.resize(cells);
+    cellSpeedStddev.resize(cells);
+    cellPower.resize(cells);
+    cellVarianceSlope.resize(cells);
+    cellVarianceOffset.resize(cells);
+    cellLinearFrom.resize(cells);
+    cellRow.resize(cells);
+
+    for (int cell = 0; cell < cells; cell++) {
+        int row;
+        double t;
+        if (cell < hoverCell) {
+            double angle = cellAngle[cell];
+            row = 0;
+            while (row < (int) angles.size() - 2 && angle >= angles[row + 1]) {
+                row++;
+            }
+            t = (angle - angles[row]) / (angles[row + 1] - angles[row]);
+            cellSpeedMean[cell] = data.speedMean[row] + (data.speedMean[row + 1] - data.speedMean[row]) * t;
+            cellSpeedStddev[cell] = data.speedStddev[row] + (data.speedStddev[row + 1] - data.speedStddev[row]) * t;
+            cellPower[cell] = data.power[row] + (data.power[row + 1] - data.power[row]) * t;
+        }
+        else {
+            row = hoverRow;
+            t = 0;
+            cellSpeedMean[cell] = 1;
+            cellSpeedStddev[cell] = 0;
+            cellPower[cell] = data.hoverPower;
+        }
+        cellRow[cell] = row;
+        cellVarianceSlope[cell] = slope[row] + (slope[row + 1] - slope[row]) * t;
+        cellVarianceOffset[cell] = offset[row] + (offset[row + 1] - offset[row]) * t;
+        cellLinearFrom[cell] = std::max(linearFrom[row], linearFrom[row + 1]);
+    }
+}
+
+std::shared_ptr<const EnergyModel> EnergyModel::getShared(const std::string& fileName, double angleResolution)
+{
+    // loaded models by file and resolution, released when the last node is gone
+    static std::map<std::pair<std::string, double>, std::weak_ptr<const EnergyModel>> models;
+
+    std::weak_ptr<const EnergyModel>& entry = models[std::make_pair(fileName, angleResolution)];
+    std::shared_ptr<const EnergyModel> model = entry.lock();
+    if (!model) {
+        EnergyModelData data = fileName.empty() ? EnergyModelData::fromEmpiricData() : EnergyModelData::readFile(fileName);
+        model = std::make_shared<const EnergyModel>(data, angleResolution);
+        entry = model;
+    }
+    return model;
+}
+
+void EnergyModel::predictLegs(const LegBatch& batch, double quantileZ, LegPredictions& results, bool vectorized) const
+{
+    results.resize(batch.size());
+    prepareLegs(batch, results);
+
+    size_t leg = 0;
+    if (vectorized && hasVectorKernel()) {
+        predictLegsVectorized(leg, quantileZ, results);
+    }
+    for (; leg < batch.size(); leg++) {
+        TablePosition position = { results.row[leg], results.weight[leg], results.cell[leg], results.cellWeight[leg] };
+        LegPrediction prediction = predict(position, results.distance[leg], quantileZ);
+        results.energyMean[leg] = prediction.energyMean;
+        results.energyVariance[leg] = prediction.energyVariance;
+        results.energyQuantile[leg] = prediction.energyQuantile;
+        results.duration[leg] = prediction.duration;
+        results.durationQuantile[leg] = prediction.durationQuantile;
+    }
+}
+
+bool EnergyModel::hasVectorKernel()
+{
+#ifdef ENERGYMODEL_AVX2
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return supported;
+#else
+    return false;
+#endif
+}
+
+LegPrediction EnergyModel::predictMovement(double dx, double dy, double dz, double quantileZ) const
+{
+    double distance, angle;
+    getLegGeometry(dx, dy, dz, distance, angle);
+    return predict(locateAngle(angle), distance, quantileZ);
+}
+
+LegPrediction EnergyModel::predictHold(double seconds, double quantileZ) const
+{
+    return predict(locateHover(), seconds, quantileZ);
+}
+
+void EnergyModel::getSpeed(double angle, double& mean, double& stddev) const
+{
+    TablePosition position = locateAngle(angle);
+    int cell = position.cell;
+    mean = cellSpeedMean[cell] + (cellSpeedMean[cell + 1] - cellSpeedMean[cell]) * position.cellWeight;
+    stddev = cellSpeedStddev[cell] + (cellSpeedStddev[cell + 1] - cellSpeedStddev[cell]) * position.cellWeight;
+}
+
+void EnergyModel::getMovementEnergy(double angle, double duration, double& mean, double& variance) const
+{
+    getEnergy(locateAngle(angle), duration, mean, variance);
+}
+
+void EnergyModel::getHoverEnergy(double duration, double& mean, double& variance) const
+{
+    getEnergy(locateHover(), duration, mean, variance);
+}
+
+/**
+ * Scalar pass: distance, climb angle and table position of every leg (atan2 does not vectorize).
+ */
+void EnergyModel::prepareLegs(const LegBatch& batch, LegPredictions& results) const
+{
+    for (size_t leg = 0; leg < batch.size(); leg++) {
+        TablePosition position;
+        if (batch.holdSeconds[leg] > 0) {
+            results.distance[leg] = batch.holdSeconds[leg];
+            position = locateHover();
+        }
+        else {
+            double angle;
+            getLegGeometry(batch.dx[leg], batch.dy[leg], batch.dz[leg], results.distance[leg], angle);
+            position = locateAngle(angle);
+        }
+        results.row[leg] = position.row;
+        results.weight[leg] = position.weight;
+        results.cell[leg] = position.cell;
+        results.cellWeight[leg] = position.cellWeight;
+    }
+}
+
+/**
+ * Distance [m] and climb angle [°] of a movement, with the same rounding of tiny components as WaypointCEE
+ */
+void EnergyModel::getLegGeometry(double dx, double dy, double dz, double& distance, double& angle)
+{
+    if (fabs(dx) < 1.e-10) dx = 0;
+    if (fabs(dy) < 1.e-10) dy = 0;
+    if (fabs(dz) < 1.e-10) dz = 0;
+    distance = sqrt(dx * dx + dy * dy + dz * dz);
+    if (distance < 1.e-10) distance = 0;
+    angle = atan2(dz, sqrt(dx * dx + dy * dy)) / M_PI * 180;
+}
+
+/**
+ * Table position of the given climb angle. The fine cell is found by index computation of its angle step
+ * (and skipping a measured angle within the step), the measured row is the row of the cell.
+ */
+EnergyModel::TablePosition EnergyModel::locateAngle(double angle) const
+{
+    TablePosition position;
+    angle = fmin(fmax(angle, angles.front()), angles.back());
+
+    int step = std::min((int) ((angle - angles.front()) / angleResolution), (int) stepCell.size() - 1);
+    int cell = stepCell[step];
+    while (cell < hoverCell - 2 && angle >= cellAngle[cell + 1]) {
+        cell++;
+    }
+    position.cell = cell;
+    position.cellWeight = (angle - cellAngle[cell]) / (cellAngle[cell + 1] - cellAngle[cell]);
+
+    int row = cellRow[cell];
+    position.row = row;
+    position.weight = (angle - angles[row]) / (angles[row + 1] - angles[row]);
+    return position;
+}
+
+EnergyModel::TablePosition EnergyModel::locateHover() const
+{
+    TablePosition position = { hoverRow, 0, hoverCell, 0 };
+    return position;
+}
+
+/**
+ * ACF variance inference method by Prof Hotz (compare chapter 4.4. of thesis) for the maneuver in table row 'row'
+ * over the given number of lag samples n:
+ *   n * lag[0] + 2 * sum_{h=1}^{min(n-1, maxLag)} (n - h) * lag[h]
+ * The sum collapses to n * lagSum[h] - lagWeightedSum[h], i.e. constant time for any duration.
+ */
+double EnergyModel::getVariance(int row, int samples) const
+{
+    int h = std::min(samples - 1, maxLag[row]);
+    int idx = row * lagsPerRow + h;
+    double variance = samples * lag0[row] + 2 * (samples * lagSum[idx] - lagWeightedSum[idx]);
+    return fabs(variance) / ((double) lagSamplesPerSecond * lagSamplesPerSecond * lagSamplesPerSecond);
+}
+
+/**
+ * Consumption mean [mAh] and variance [mAh^2] of a maneuver of the given duration.
+ * Once all lags are in use the variance is linear in the number of samples and taken from the fine grid,
+ * shorter maneuvers are interpolated between the two measured rows.
+ * Maneuvers shorter than MIN_LEG_DURATION do not consume energy.
+ */
+void EnergyModel::getEnergy(const TablePosition& position, double duration, double& mean, double& variance) const
+{
+    if (duration < MIN_LEG_DURATION) {
+        mean = 0;
+        variance = 0;
+        return;
+    }
+    double mAhPerWh = 1000 / voltage;
+    int cell = position.cell;
+    double u = position.cellWeight;
+    double power = cellPower[cell] + (cellPower[cell + 1] - cellPower[cell]) * u;
+    mean = power * duration / 3600 * mAhPerWh;
+
+    int samples = std::max(1, (int) fmin(duration * lagSamplesPerSecond, MAX_LAG_SAMPLES));
+    if (samples >= std::max(cellLinearFrom[cell], cellLinearFrom[cell + 1])) {
+        double slope = cellVarianceSlope[cell] + (cellVarianceSlope[cell + 1] - cellVarianceSlope[cell]) * u;
+        double offset = cellVarianceOffset[cell] + (cellVarianceOffset[cell + 1] - cellVarianceOffset[cell]) * u;
+        variance = slope * samples - offset;
+    }
+    else {
+        double variance0 = getVariance(position.row, samples);
+        variance = (variance0 + (getVariance(position.row + 1, samples) - variance0) * position.weight) * mAhPerWh * mAhPerWh;
+    }
+}
+
+/**
+ * Scalar reference implementation of the leg prediction, also used for the remainder of the vectorized loop.
+ */
+LegPrediction EnergyModel::predict(const TablePosition& position, double distance, double quantileZ) const
+{
+    LegPrediction prediction;
+    int cell = position.cell;
+    double u = position.cellWeight;
+    double speed = cellSpeedMean[cell] + (cellSpeedMean[cell + 1] - cellSpeedMean[cell]) * u;
+    double speedDeviation = cellSpeedStddev[cell] + (cellSpeedStddev[cell + 1] - cellSpeedStddev[cell]) * u;
+
+    prediction.duration = distance / speed;
+    prediction.durationQuantile = distance / (speed - quantileZ * speedDeviation);
+    getEnergy(position, prediction.duration, prediction.energyMean, prediction.energyVariance);
+    prediction.energyQuantile = prediction.energyMean + quantileZ * sqrt(prediction.energyVariance);
+    return prediction;
+}
+
+#ifdef ENERGYMODEL_AVX2
+namespace {
+// the masked gather with a defined source, the unmasked one trips -Wmaybe-uninitialized in GCC's intrinsics header
+AVX2_TARGET inline __m256d gather(const std::vector<double>& table, __m128i idx)
+{
+    return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), table.data(), idx, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+}
+
+AVX2_TARGET inline __m256d lerp(__m256d v0, __m256d v1, __m256d t)
+{
+    return _mm256_add_pd(v0, _mm256_mul_pd(_mm256_sub_pd(v1, v0), t));
+}
+}
+
+/**
+ * AVX2 version of predict() for four legs at a time. Advances 'leg' past the processed legs.
+ * Only to be called if hasVectorKernel().
+ */
+AVX2_TARGET void EnergyModel::predictLegsVectorized(size_t& leg, double quantileZ, LegPredictions& results) const
+{
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i rowStride = _mm_set1_epi32(lagsPerRow);
+    const __m256d z = _mm256_set1_pd(quantileZ);
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    const __m256d samplesPerSecond = _mm256_set1_pd(lagSamplesPerSecond);
+    const __m256d maxSamples = _mm256_set1_pd(MAX_LAG_SAMPLES);
+    const __m256d mAhPerWh = _mm256_set1_pd(1000 / voltage);
+    const __m256d varianceScale = _mm256_set1_pd(1000 / voltage * 1000 / voltage
+            / ((double) lagSamplesPerSecond * lagSamplesPerSecond * lagSamplesPerSecond));
+    const __m256d secondsPerHour = _mm256_set1_pd(3600);
+    const __m256d minDuration = _mm256_set1_pd(MIN_LEG_DURATION);
+
+    for (; leg + 4 <= results.size(); leg += 4) {
+        __m128i row0 = _mm_loadu_si128((const __m128i *) &results.row[leg]);
+        __m128i row1 = _mm_add_epi32(row0, one);
+        __m256d t = _mm256_loadu_pd(&results.weight[leg]);
+        __m128i cell0 = _mm_loadu_si128((const __m128i *) &results.cell[leg]);
+        __m128i cell1 = _mm_add_epi32(cell0, one);
+        __m256d u = _mm256_loadu_pd(&results.cellWeight[leg]);
+        __m256d distance = _mm256_loadu_pd(&results.distance[leg]);
+
+        __m256d speed = lerp(gather(cellSpeedMean, cell0), gather(cellSpeedMean, cell1), u);
+        __m256d speedDeviation = lerp(gather(cellSpeedStddev, cell0), gather(cellSpeedStddev, cell1), u);
+        __m256d power = lerp(gather(cellPower, cell0), gather(cellPower, cell1), u);
+
+        __m256d duration = _mm256_div_pd(distance, speed);
+        __m256d durationQuantile = _mm256_div_pd(distance, _mm256_sub_pd(speed, _mm256_mul_pd(z, speedDeviation)));
+
+        __m256d scaledDuration = _mm256_min_pd(_mm256_mul_pd(duration, samplesPerSecond), maxSamples);
+        __m128i samples = _mm_max_epi32(_mm256_cvttpd_epi32(scaledDuration), one);
+        __m256d samplesD = _mm256_cvtepi32_pd(samples);
+
+        // short maneuvers: interpolate the variance between the measured rows
+        __m256d variance[2];
+        __m128i rows[2] = { row0, row1 };
+        for (int i = 0; i < 2; i++) {
+            __m128i h = _mm_min_epi32(_mm_sub_epi32(samples, one), _mm_i32gather_epi32(maxLag.data(), rows[i], 4));
+            __m128i idx = _mm_add_epi32(_mm_mullo_epi32(rows[i], rowStride), h);
+            __m256d sum = gather(lagSum, idx);
+            __m256d weightedSum = gather(lagWeightedSum, idx);
+            __m256d v = _mm256_mul_pd(samplesD, gather(lag0, rows[i]));
+            v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_set1_pd(2), _mm256_sub_pd(_mm256_mul_pd(samplesD, sum), weightedSum)));
+            variance[i] = _mm256_mul_pd(_mm256_andnot_pd(signMask, v), varianceScale);
+        }
+        __m256d var = lerp(variance[0], variance[1], t);
+
+        // long maneuvers: linear variance from the fine grid
+        __m256d slope = lerp(gather(cellVarianceSlope, cell0), gather(cellVarianceSlope, cell1), u);
+        __m256d offset = lerp(gather(cellVarianceOffset, cell0), gather(cellVarianceOffset, cell1), u);
+        __m128i linearFrom = _mm_max_epi32(_mm_i32gather_epi32(cellLinearFrom.data(), cell0, 4),
+                _mm_i32gather_epi32(cellLinearFrom.data(), cell1, 4));
+        __m256d linear = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpgt_epi32(_mm_add_epi32(samples, one), linearFrom)));
+        var = _mm256_blendv_pd(var, _mm256_sub_pd(_mm256_mul_pd(slope, samplesD), offset), linear);
+
+        __m256d mean = _mm256_mul_pd(_mm256_div_pd(_mm256_mul_pd(power, duration), secondsPerHour), mAhPerWh);
+
+        // legs below the minimum duration do not consume energy
+        __m256d tooShort = _mm256_cmp_pd(duration, minDuration, _CMP_LT_OQ);
+        mean = _mm256_andnot_pd(tooShort, mean);
+        var = _mm256_andnot_pd(tooShort, var);
+        __m256d quantile = _mm256_add_pd(mean, _mm256_mul_pd(z, _mm256_sqrt_pd(var)));
+
+        _mm256_storeu_pd(&results.duration[leg], duration);
+        _mm256_storeu_pd(&results.durationQuantile[leg], durationQuantile);
+        _mm256_storeu_pd(&results.energyMean[leg], mean);
+        _mm256_storeu_pd(&results.energyVariance[leg], var);
+        _mm256_storeu_pd(&results.energyQuantile[leg], quantile);
+    }
+}
+#else
+void EnergyModel::predictLegsVectorized(size_t&, double, LegPredictions&) const
+{
+}
+#endif
@@ -0,0 +1,271 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef ENERGYMODEL_H_
+#define ENERGYMODEL_H_
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+
+/**
+ * A batch of maneuvers (legs) to be predicted at once, stored as struct of arrays.
+ * A leg is either a movement by (dx, dy, dz) in [m] or, if holdSeconds > 0, hovering on the spot for holdSeconds.
+ */
+struct LegBatch {
+    std::vector<double> dx, dy, dz;
+    std::vector<double> holdSeconds;
+
+    void addMovement(double dx, double dy, double dz)
+    {
+        this->dx.push_back(dx);
+        this->dy.push_back(dy);
+        this->dz.push_back(dz);
+        this->holdSeconds.push_back(0);
+    }
+    void addHold(double seconds)
+    {
+        this->dx.push_back(0);
+        this->dy.push_back(0);
+        this->dz.push_back(0);
+        this->holdSeconds.push_back(seconds);
+    }
+    void reserve(size_t count)
+    {
+        dx.reserve(count);
+        dy.reserve(count);
+        dz.reserve(count);
+        holdSeconds.reserve(count);
+    }
+    void clear()
+    {
+        dx.clear();
+        dy.clear();
+        dz.clear();
+        holdSeconds.clear();
+    }
+    size_t size() const
+    {
+        return dx.size();
+    }
+};
+
+/**
+ * Prediction for a single leg. Energies in [mAh] (variance in [mAh^2]), durations in [s].
+ */
+struct LegPrediction {
+    double energyMean;
+    double energyVariance;
+    double energyQuantile;
+    double duration;
+    double durationQuantile;
+};
+
+/**
+ * Predictions for a LegBatch, one entry per leg and field.
+ * Energies in [mAh] (variance in [mAh^2]), durations in [s].
+ * Can be reused over several predictLegs() calls to avoid reallocations.
+ */
+struct LegPredictions {
+    std::vector<double> energyMean;
+    std::vector<double> energyVariance;
+    std::vector<double> energyQuantile;
+    std::vector<double> duration;
+    std::vector<double> durationQuantile;
+
+    /// per leg intermediate values of the prediction: travelled distance and position in the angle tables
+    std::vector<double> distance;
+    std::vector<int> row;
+    std::vector<double> weight;
+    std::vector<int> cell;
+    std::vector<double> cellWeight;
+
+    void resize(size_t count);
+    size_t size() const
+    {
+        return duration.size();
+    }
+};
+
+/**
+ * Measured characteristics of an airframe, the input of an EnergyModel.
+ * One entry per measured climb angle (ascending, typically -90..+90°) plus the hovering characteristics.
+ *
+ * Text file format, one record per line, '#' starts a comment:
+ * <pre>
+ * voltage <battery voltage [V]>
+ * lagSamplesPerSecond <sampling rate of the power measurements [1/s]>
+ * hover <mean power [W]> <PACF lag 1> <PACF lag 2> ...
+ * angle <climb angle [°]> <mean speed [m/s]> <speed stddev [m/s]> <mean power [W]> <PACF lag 1> <PACF lag 2> ...
+ * </pre>
+ */
+struct EnergyModelData {
+    double voltage = 0;
+    int lagSamplesPerSecond = 0;
+
+    std::vector<double> angle;
+    std::vector<double> speedMean;
+    std::vector<double> speedStddev;
+    std::vector<double> power;
+    std::vector<std::vector<double>> lags;
+
+    double hoverPower = 0;
+    std::vector<double> hoverLags;
+
+    /**
+     * The 3DR Solo measurements compiled in from UAVSoloEmpiricData.h
+     */
+    static EnergyModelData fromEmpiricData();
+
+    /**
+     * Parse a model file in the format above, throws cRuntimeError on malformed content.
+     */
+    static EnergyModelData readFile(const std::string& fileName);
+
+    /**
+     * Throws cRuntimeError if the data can not be used for a model.
+     */
+    void validate(const std::string& origin) const;
+};
+
+/**
+ * Statistical energy and speed model of the UAV based on measurement data (EnergyModelData).
+ * The tables are kept as flat arrays in a layout suited for batched (SIMD) prediction:
+ * one row per measured climb angle plus a (duplicated) row for hovering.
+ *
+ * Speed, power and the variance of long maneuvers are additionally pre-interpolated on a fine angle grid
+ * (cells of angleResolution degrees, again followed by two hover cells), so a climb angle maps to its cell
+ * by a single index computation instead of a search through the measured angles.
+ * The measured angles are breakpoints of the grid as well: no cell spans a measured angle,
+ * so the fine grid reproduces the piecewise linear interpolation between the measured rows.
+ *
+ * All predictions are pure functions of their arguments (no node, no RNG, no allocation),
+ * shared by the CEEs during execution and by all estimations.
+ * A model is immutable after construction, nodes using the same data share one instance (see getShared()).
+ */
+class EnergyModel {
+public:
+    EnergyModel(const EnergyModelData& data, double angleResolution = DEFAULT_ANGLE_RESOLUTION);
+
+    /// Default resolution of the fine angle grid, in [°]
+    static constexpr double DEFAULT_ANGLE_RESOLUTION = 0.25;
+
+    /**
+     * Shared model for the given model file, loaded on first request.
+     * The model stays loaded as long as any node holds it.
+     *
+     * @param fileName Model file, see EnergyModelData. Empty for the compiled-in measurement data.
+     * @param angleResolution Resolution of the fine angle grid, in [°]
+     */
+    static std::shared_ptr<const EnergyModel> getShared(const std::string& fileName, double angleResolution = DEFAULT_ANGLE_RESOLUTION);
+
+    /**
+     * Predict energy and duration for all legs of the batch.
+     * Equivalent to getMovementConsumption()/getHoverConsumption() and the speed prediction of UAVNode,
+     * using the mean speed for the duration and the given standard normal z-score for all quantiles.
+     *
+     * @param batch The legs to predict
+     * @param quantileZ z-score of the prediction quantile
+     * @param results Predictions, resized to the batch size
+     * @param vectorized Use the AVX2 kernel if available (see hasVectorKernel()), false for the scalar implementation only
+     */
+    void predictLegs(const LegBatch& batch, double quantileZ, LegPredictions& results, bool vectorized = true) const;
+
+    /**
+     * Whether predictLegs() runs the AVX2 kernel, i.e. the build targets x86-64 and the CPU supports AVX2
+     */
+    static bool hasVectorKernel();
+
+    /**
+     * Predict a single movement by (dx, dy, dz) in [m], like a WaypointCEE from its origin to its destination.
+     */
+    LegPrediction predictMovement(double dx, double dy, double dz, double quantileZ) const;
+
+    /**
+     * Predict hovering on the spot for the given number of seconds, like a HoldPositionCEE.
+     */
+    LegPrediction predictHold(double seconds, double quantileZ) const;
+
+    /**
+     * Mean and standard deviation of the speed in [m/s] at the given climb angle (-90..+90°)
+     */
+    void getSpeed(double angle, double& mean, double& stddev) const;
+
+    /**
+     * Mean [mAh] and variance [mAh^2] of the consumption of a movement at the given climb angle (-90..+90°) and duration [s]
+     */
+    void getMovementEnergy(double angle, double duration, double& mean, double& variance) const;
+
+    /**
+     * Mean [mAh] and variance [mAh^2] of the consumption of hovering for the given duration [s]
+     */
+    void getHoverEnergy(double duration, double& mean, double& variance) const;
+
+protected:
+    /**
+     * Position of a maneuver in the tables: measured row and fine cell, each with the interpolation weight towards the next one
+     */
+    struct TablePosition {
+        int row;
+        double weight;
+        int cell;
+        double cellWeight;
+    };
+
+    /// Battery voltage [V] and sampling rate of the lags [1/s] of the model data
+    double voltage;
+    int lagSamplesPerSecond;
+
+    /// Number of samples per lag row in the lag prefix tables
+    int lagsPerRow;
+    /// Rows of the measured tables: one per angle, hover row duplicated at the end for branch-free interpolation
+    int hoverRow;
+
+    std::vector<double> angles;
+    std::vector<double> lag0;
+    std::vector<int> maxLag;
+    std::vector<double> lagSum;
+    std::vector<double> lagWeightedSum;
+
+    /// Fine angle grid, in [°]
+    double angleResolution;
+    /// Cells of the fine grid: one per angle step, split at measured angles, hover cell duplicated at the end
+    int hoverCell;
+    /// Start angle [°] of every angle cell, and per angle step the cell its start falls into
+    std::vector<double> cellAngle;
+    std::vector<int> stepCell;
+
+    std::vector<double> cellSpeedMean;
+    std::vector<double> cellSpeedStddev;
+    std::vector<double> cellPower;
+    /// variance [mAh^2] = slope * samples - offset, valid from linearFrom samples on (all lags in use)
+    std::vector<double> cellVarianceSlope;
+    std::vector<double> cellVarianceOffset;
+    std::vector<int> cellLinearFrom;
+    std::vector<int> cellRow;
+
+    static void getLegGeometry(double dx, double dy, double dz, double& distance, double& angle);
+    void buildAngleCells(const EnergyModelData& data);
+    TablePosition locateAngle(double angle) const;
+    TablePosition locateHover() const;
+    void prepareLegs(const LegBatch& batch, LegPredictions& results) const;
+    void getEnergy(const TablePosition& position, double duration, double& mean, double& variance) const;
+    LegPrediction predict(const TablePosition& position, double distance, double quantileZ) const;
+    void predictLegsVectorized(size_t& leg, double quantileZ, LegPredictions& results) const;
+    double getVariance(int row, int samples) const;
+};
+
+#endif /* ENERGYMODEL_H_ */
@@ -149,6 +149,7 @@ void GenericNode::handleMessage(cMessage *msg)
     double stepSize = 0;
     if (msg->isName("startProvision")) {
         MissionMsg *mmmsg = check_and_cast<MissionMsg *>(msg);
+        commandArena.adopt(mmmsg->getMission());
         if (not mmmsg->getMission().empty()) loadCommands(mmmsg->getMission(), false);
         if (activeInField) {
             EV_INFO << "UAV initialized for provisioning " << endl;
@@ -170,9 +171,13 @@ void GenericNode::handleMessage(cMessage *msg)
     else if (msg->isName("startMission")) {
         activeInField = true;
         MissionMsg *mmmsg = check_and_cast<MissionMsg *>(msg);
-        if (not mmmsg->getMission().empty()) loadCommands(mmmsg->getMission());
         commandsRepeat = mmmsg->getMissionRepeat();
         missionId = mmmsg->getMissionId();
+        if (mmmsg->getProgram()) loadProgram(mmmsg->getProgram(), mmmsg->getProgramCounter(), mmmsg->getProgramWrapped());
+        else if (not mmmsg->getMission().empty()) {
+            commandArena.adopt(mmmsg->getMission());
+            loadCommands(mmmsg->getMission());
+        }
         collectStatistics();
         selectNextCommand();
         initializeState();
@@ -255,6 +260,21 @@ bool GenericNode::hasCommandsInQueue()
     return (not cees.empty());
 }
 
+/**
+ * Load the commands of a mission program still to execute from the program counter on, see MissionProgram::getSequence().
+ * Nodes executing missions override this to reuse their CEEs of the program.
+ */
+void GenericNode::loadProgram(const MissionProgramHandle& program, size_t programCounter, bool programWrapped)
+{
+    std::vector<size_t> indices;
+    program->getSequence(programCounter, commandsRepeat, programWrapped, indices);
+    CommandQueue commands;
+    for (size_t index : indices) {
+        commands.push_back(program->at(index));
+    }
+    loadCommands(commands);
+}
+
 /**
  * Delete the current commands/CEEs from nodes memory
  */
@@ -262,6 +282,7 @@ void GenericNode::clearCommands()
 {
     //if (activeInField and not cees.empty()) EV_INFO << __func__ << "(): Pre-existing CEEs removed from node." << endl;
     cees.clear();
+    commandArena.collect(cees, commandExecEngine);
 }
 
 /**
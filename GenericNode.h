@@ -30,6 +30,7 @@
 
 #include "Command.h"
 #include "CommandExecEngine.h"
+#include "CommandArena.h"
 #include "msgs/MissionMsg_m.h"
 #include "msgs/CmdCompletedMsg_m.h"
 #include "ReplacementData.h"
@@ -83,6 +84,9 @@ protected:
     /// Instance of CEE subclass, contains current command
     CommandExecEngine *commandExecEngine = nullptr;
 
+    /// Owner of the commands and CEEs created by the node, freed at its reset points (clearing or loading commands)
+    CommandArena commandArena;
+
     /// Repeat commands, rotate queue
     bool commandsRepeat = false;
 
@@ -189,6 +193,7 @@ public:
     }
     virtual bool hasCommandsInQueue();
     virtual void loadCommands(CommandQueue commands, bool isMission = true) = 0;
+    virtual void loadProgram(const MissionProgramHandle& program, size_t programCounter, bool programWrapped);
     virtual void clearCommands();
     virtual CommandQueue* extractCommands();
     virtual CommandQueue* extractAllCommands();
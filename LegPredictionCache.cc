@@ -0,0 +1,90 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <cmath>
+#include <cstring>
+
+#include "LegPredictionCache.h"
+
+LegPredictionCache::LegPredictionCache(size_t capacity, double resolution)
+{
+    configure(capacity, resolution);
+}
+
+void LegPredictionCache::configure(size_t capacity, double resolution)
+{
+    size_t size = 0;
+    if (capacity > 0) {
+        size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+    }
+    entries.assign(size, Entry());
+    this->resolution = resolution;
+}
+
+void LegPredictionCache::clear()
+{
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        it->valid = false;
+    }
+}
+
+/**
+ * Quantize the endpoints into key and return the slot of the key in the table.
+ */
+size_t LegPredictionCache::makeKey(double fromX, double fromY, double fromZ, double toX, double toY, double toZ, double quantileZ, int64_t key[6]) const
+{
+    double coordinates[6] = { fromX, fromY, fromZ, toX, toY, toZ };
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < 6; i++) {
+        key[i] = (int64_t) llround(coordinates[i] / resolution);
+        hash = (hash ^ (uint64_t) key[i]) * 1099511628211ULL;
+    }
+    uint64_t quantileBits;
+    memcpy(&quantileBits, &quantileZ, sizeof(quantileBits));
+    hash = (hash ^ quantileBits) * 1099511628211ULL;
+    return (size_t) (hash ^ (hash >> 32)) & (entries.size() - 1);
+}
+
+bool LegPredictionCache::lookup(double fromX, double fromY, double fromZ, double toX, double toY, double toZ, double quantileZ, double& energy, double& duration)
+{
+    if (entries.empty()) return false;
+
+    int64_t key[6];
+    const Entry& entry = entries[makeKey(fromX, fromY, fromZ, toX, toY, toZ, quantileZ, key)];
+    if (entry.valid && entry.quantileZ == quantileZ && memcmp(entry.key, key, sizeof(key)) == 0) {
+        energy = entry.energy;
+        duration = entry.duration;
+        hits++;
+        return true;
+    }
+    misses++;
+    return false;
+}
+
+void LegPredictionCache::insert(double fromX, double fromY, double fromZ, double toX, double toY, double toZ, double quantileZ, double energy, double duration)
+{
+    if (entries.empty()) return;
+
+    int64_t key[6];
+    Entry& entry = entries[makeKey(fromX, fromY, fromZ, toX, toY, toZ, quantileZ, key)];
+    entry.valid = true;
+    memcpy(entry.key, key, sizeof(key));
+    entry.quantileZ = quantileZ;
+    entry.energy = energy;
+    entry.duration = duration;
+}
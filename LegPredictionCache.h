@@ -0,0 +1,75 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef LEGPREDICTIONCACHE_H_
+#define LEGPREDICTIONCACHE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Bounded cache for predictions of point-to-point flights (legs), e.g. the return flight to a charging node.
+ * Endpoints are quantized to the given resolution and combined with the prediction quantile as key.
+ * The cache is direct mapped: a colliding insert replaces the previous entry.
+ */
+class LegPredictionCache {
+public:
+    /**
+     * @param capacity Number of cached legs, rounded up to a power of two. 0 disables the cache.
+     * @param resolution Quantization of the endpoints, in [m], positive
+     */
+    LegPredictionCache(size_t capacity = 0, double resolution = 0.01);
+
+    void configure(size_t capacity, double resolution);
+
+    /**
+     * Look up a leg, counts as hit or miss.
+     *
+     * @return true if found, energy [mAh] and duration [s] are set then
+     */
+    bool lookup(double fromX, double fromY, double fromZ, double toX, double toY, double toZ, double quantileZ, double& energy, double& duration);
+
+    void insert(double fromX, double fromY, double fromZ, double toX, double toY, double toZ, double quantileZ, double energy, double duration);
+
+    void clear();
+
+    long getHits() const
+    {
+        return hits;
+    }
+    long getMisses() const
+    {
+        return misses;
+    }
+
+protected:
+    struct Entry {
+        bool valid = false;
+        int64_t key[6];
+        double quantileZ;
+        double energy;
+        double duration;
+    };
+
+    std::vector<Entry> entries;
+    double resolution;
+    long hits = 0;
+    long misses = 0;
+
+    size_t makeKey(double fromX, double fromY, double fromZ, double toX, double toY, double toZ, double quantileZ, int64_t key[6]) const;
+};
+
+#endif /* LEGPREDICTIONCACHE_H_ */
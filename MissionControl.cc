@@ -15,19 +15,37 @@
 
 #ifdef WITH_OSG
 #include "MissionControl.h"
+#include <algorithm>
+#include <chrono>
 #include <boost/algorithm/string.hpp>
-#include "msgs/MobileNodeRequest_m.h"
 #include "msgs/MissionMsg_m.h"
 
 Define_Module(MissionControl);
 
+/// Cost of assigning a node that would not reach the replacement location with charge left
+#define INFEASIBLE_ASSIGNMENT_COST 1e9
+
+MissionControl::~MissionControl()
+{
+    cancelAndDelete(assignReplacementsMsg);
+}
+
 void MissionControl::initialize()
 {
+    replacementBatchWindow = par("replacementBatchWindow");
+    replacementLatenessCost = par("replacementLatenessCost");
+    assignReplacementsMsg = new cMessage("assignReplacements");
+    WATCH(replacementBatches);
+    WATCH(replacementBatchMaxRequests);
+    WATCH(replacementBatchSolveTime);
+
     std::vector<std::string> missionFiles;
     const char* missionFilesString = par("missionFiles").stringValue();
     boost::split(missionFiles, missionFilesString, boost::algorithm::is_any_of(","), boost::token_compress_on);
+    MissionLoader missionLoader(getSystemModule()->par("playgroundLatitude"), getSystemModule()->par("playgroundLongitude"), par("polyAltitude"),
+            par("missionCache"));
     for (auto it = missionFiles.begin(); it != missionFiles.end(); it++) {
-        missionQueue.push_back(loadCommandsFromWaypointsFile(it->c_str()));
+        missionQueue.push_back(std::make_shared<const MissionProgram>(missionLoader.load(*it)));
     }
 
     // Add all GenericNodes to managedNodes list (map)
@@ -47,6 +65,7 @@ void MissionControl::initialize()
         send(new cMessage("initIdle"), "gate$o", module->getIndex());
 
     }
+    subscribeChargingUpdates();
     cMessage *start = new cMessage("startScheduling");
     scheduleAt(par("startTime"), start);
 }
@@ -72,22 +91,36 @@ void MissionControl::finish()
         EV_ERROR << "Finish Check: Mission count mismatch! (" << missioncount << "/" << missionQueue.size() << ")" << endl;
     }
 
+    if (replacementBatchWindow > 0) {
+        recordScalar("replacementBatches", replacementBatches);
+        recordScalar("replacementBatchMaxRequests", replacementBatchMaxRequests);
+        recordScalar("replacementBatchMaxCandidates", replacementBatchMaxCandidates);
+        // the wall-clock solve time is logged only, result files have to be reproducible
+        EV_DETAIL << "Finish Checks: " << replacementBatches << " replacement batches solved in " << replacementBatchSolveTime << "s" << endl;
+    }
 }
 
 void MissionControl::handleMessage(cMessage *msg)
 {
+    if (msg == assignReplacementsMsg) {
+        assignReplacements();
+        return;
+    }
     if (msg->isName("startScheduling")) {
+        // nodes were added before their initialization, take their start positions
+        managedNodeShadows.updatePositions();
         for (auto it = missionQueue.begin(); it != missionQueue.end(); it++) {
-            CommandQueue mission = *it;
+            const MissionProgramHandle& program = *it;
             int missionId = it - missionQueue.begin();
 
             //Select free idle node
-            NodeShadow *nodeShadow = managedNodeShadows.getClosest(NodeStatus::IDLE, mission.front()->getX(), mission.front()->getY(), mission.front()->getZ());
+            NodeShadow *nodeShadow = managedNodeShadows.getClosest(NodeStatus::IDLE, program->at(0)->getX(), program->at(0)->getY(), program->at(0)->getZ());
 
             // Generate and send out start mission message
             MissionMsg *nodeStartMission = new MissionMsg("startMission");
             nodeStartMission->setMissionId(missionId);
-            nodeStartMission->setMission(mission);
+            nodeStartMission->setProgram(program);
+            nodeStartMission->setProgramCounter(0);
             nodeStartMission->setMissionRepeat(true);
             send(nodeStartMission, "gate$o", nodeShadow->getNodeIndex());
 
@@ -120,23 +153,18 @@ void MissionControl::handleMessage(cMessage *msg)
     }
     else if (msg->isName("chargingUpdate")) {
         UpdateChargingMsg* ucmsg = check_and_cast<UpdateChargingMsg*>(msg);
-        std::vector<std::string> nodes;
-        std::vector<std::string> info;
-        const char* nodeString = ucmsg->getUpdate();
-        if (std::strlen(nodeString) > 0) {
-            boost::split(nodes, nodeString, boost::algorithm::is_any_of(";"), boost::token_compress_on);
-            for (auto it = nodes.cbegin(); it != nodes.cend() && (std::strlen(it->c_str()) > 0); it++) {
-                boost::split(info, *it, boost::algorithm::is_any_of(","), boost::token_compress_on);
-                NodeShadow* shadow = managedNodeShadows.get(std::stoi(info.at(0)));
-                shadow->setKnownBattery(new Battery(std::stof(info.at(2)), std::stof(info.at(1))));
-                if (not shadow->isStatusReserved()) {
-                    if (shadow->getKnownBattery()->getRemainingPercentage() > 99)
-                        shadow->setStatus(NodeStatus::IDLE);
-                    else
-                        shadow->setStatus(NodeStatus::CHARGING);
-                    EV_TRACE << "shadow node update:" << shadow->getNode()->getFullName() << ": status:" << shadow->getStatusString() << " battery:"
-                            << shadow->getKnownBattery()->getRemainingPercentage() << "%" << endl;
-                }
+        for (unsigned int i = 0; i < ucmsg->getRecordsArraySize(); i++) {
+            const ChargingUpdateRecord& record = ucmsg->getRecords(i);
+            NodeShadow* shadow = managedNodeShadows.get(record.nodeIndex);
+            shadow->setKnownBattery(record.capacity, record.remaining);
+            if (not shadow->isStatusReserved() && not shadow->isStatusMission() && not shadow->isStatusProvisioning()) {
+                if (shadow->getKnownBattery().getRemainingPercentage() > 99)
+                    shadow->setStatus(NodeStatus::IDLE);
+                else
+                    shadow->setStatus(NodeStatus::CHARGING);
+                managedNodeShadows.updatePosition(shadow);
+                EV_TRACE << "shadow node update:" << shadow->getNode()->getFullName() << ": status:" << shadow->getStatusString() << " battery:"
+                        << shadow->getKnownBattery().getRemainingPercentage() << "%" << endl;
             }
         }
     }
@@ -188,12 +216,13 @@ void MissionControl::handleMessage(cMessage *msg)
         MobileNodeResponse *mnmsg = check_and_cast<MobileNodeResponse *>(msg);
         if (mnmsg->getNodeFound()) {
             NodeShadow* nodeShadow = managedNodeShadows.get(mnmsg->getMobileNodeIndex());
-            nodeShadow->setKnownBattery(new Battery(mnmsg->getCapacity(), mnmsg->getRemaining()));
+            nodeShadow->setKnownBattery(mnmsg->getCapacity(), mnmsg->getRemaining());
             if (not nodeShadow->isStatusReserved() && not nodeShadow->isStatusMission() && not nodeShadow->isStatusProvisioning()) {
                 if (mnmsg->getCapacity() > mnmsg->getRemaining())
                     nodeShadow->setStatus(NodeStatus::CHARGING);
                 else
                     nodeShadow->setStatus(NodeStatus::IDLE);
+                managedNodeShadows.updatePosition(nodeShadow);
             }
         }
         else {
@@ -234,10 +263,12 @@ void MissionControl::handleReplacementMessage(ReplacementData replData)
         nodeShadow->setReplacementData(new ReplacementData(replData));
         nodeShadow->setReplacingNode(replNode);
     }
+    else if (replacementBatchWindow > 0) {
+        queueReplacement(replData);
+        return;
+    }
     else {
-        // ToDo: Add highest capacity from config
-        this->requestChargedNodesInformation(5400);
-
+        // Known batteries of IDLE and CHARGING nodes are kept up to date by the charging nodes (see subscribeChargingUpdates())
         NodeShadow* replacingNodeShadow;
         switch (par("replacementSearchMethod").intValue()) {
             case 0:
@@ -253,7 +284,7 @@ void MissionControl::handleReplacementMessage(ReplacementData replData)
                 break;
             case 1:
                 // Get free IDLE or CHARGING node that will have the most charge upon arrival
-                replacingNodeShadow = managedNodeShadows.getHighestChargeAtReplacement(replData.x, replData.y, replData.z);
+                replacingNodeShadow = managedNodeShadows.getHighestChargeAtReplacement(replData.x, replData.y, replData.z, replData.timeOfReplacement);
                 break;
             default:
                 throw cRuntimeError("Unknown replacementSearchMethod.");
@@ -271,31 +302,25 @@ void MissionControl::handleReplacementMessage(ReplacementData replData)
     simtime_t timeOfProvisioning;
     //Retrieve provisioning time
     UAVNode* replacingUavNode = check_and_cast<UAVNode *>(nodeShadow->getReplacingNode());
-    CommandQueue commands;
-    commands.push_back(new WaypointCommand(nodeShadow->getReplacementData()->x, nodeShadow->getReplacementData()->y, nodeShadow->getReplacementData()->z));
     simtime_t timeOfReplacement = nodeShadow->getReplacementTime();
-    CommandQueue* extractedCommands = replacingUavNode->extractAllCommands();
-    replacingUavNode->clearCommands();
-    replacingUavNode->loadCommands(commands);
-    double timeForProvisioning = replacingUavNode->estimateCommandsDuration();
+    double timeForProvisioning = replacingUavNode->estimateFlightTime(nodeShadow->getReplacementData()->x, nodeShadow->getReplacementData()->y,
+            nodeShadow->getReplacementData()->z);
     timeOfProvisioning = timeOfReplacement - timeForProvisioning;
-    replacingUavNode->clearCommands();
-    replacingUavNode->loadCommands(*extractedCommands, false);
-    delete extractedCommands;
 
-    cMessage *replacementMsg = new cMessage("provisionReplacement");
+    // Reuse a still scheduled message of this node, otherwise create one that carries the node for getNodeRequestingReplacement()
+    cMessage *replacementMsg;
+    bool reprovision = nodeShadow->hasReplacementMsg() && nodeShadow->getReplacementMsg()->isScheduled();
+    if (reprovision) {
+        replacementMsg = nodeShadow->getReplacementMsg();
+        cancelEvent(replacementMsg);
+    }
+    else {
+        replacementMsg = new cMessage("provisionReplacement");
+        replacementMsg->setContextPointer(nodeShadow);
+        nodeShadow->setReplacementMsg(replacementMsg);
+    }
 
     if (simTime() < timeOfProvisioning) {
-        // Delete and reschedule if old msg available
-        bool reprovision = false;
-        if (nodeShadow->hasReplacementMsg()) {
-            if (nodeShadow->getReplacementMsg()->isSelfMessage()) {
-                cancelEvent(nodeShadow->getReplacementMsg());
-                delete nodeShadow->getReplacementMsg();
-                reprovision = true;
-            }
-        }
-        nodeShadow->setReplacementMsg(replacementMsg);
         scheduleAt(timeOfProvisioning, replacementMsg);
         EV_INFO << __func__ << "(): " << (reprovision ? "Updating provision time." : "Provisioning node.");
         EV_INFO << " Node " << nodeShadow->getNode()->getFullName() << " will be replaced by node " << nodeShadow->getReplacingNode()->getFullName() << ".";
@@ -304,18 +329,9 @@ void MissionControl::handleReplacementMessage(ReplacementData replData)
     }
     else {
         // this happens if the replacingNode cannot reach replacement location "in time"
-
-        // cancel old message
-        if (nodeShadow->hasReplacementMsg()) {
-            if (nodeShadow->getReplacementMsg()->isSelfMessage()) {
-                cancelEvent(nodeShadow->getReplacementMsg());
-                delete nodeShadow->getReplacementMsg();
-            }
-        }
-        nodeShadow->setReplacementMsg(replacementMsg);
         timeOfProvisioning = simTime() + timeForProvisioning;
 
-        // schedule new one
+        // schedule now
         scheduleAt(simTime(), replacementMsg);
 
         EV_WARN << "Prediction time is in the past. Updating provision time.";
@@ -326,92 +342,108 @@ void MissionControl::handleReplacementMessage(ReplacementData replData)
 }
 
 /**
- * Load commands from a Mission Planner *.waypoints text file.
- * See: http://qgroundcontrol.org/mavlink/waypoint_protocol#waypoint_file_format
- *
- * @param fileName relative path to *.waypoints file
+ * Collect a replacement request for the next batch assignment, a newer request of the same node replaces the older one.
+ * The batch is assigned replacementBatchWindow after its first request.
  */
-CommandQueue MissionControl::loadCommandsFromWaypointsFile(const char* fileName)
+void MissionControl::queueReplacement(const ReplacementData& replData)
 {
-    CommandQueue commands;
-    std::ifstream inputFile(fileName);
-    int lineCnt = 1;
-    int cmdId, unknown1, unknown2, commandType;
-    std::string commandName;
-    double p1, p2, p3, p4;
-    double lat, lon, alt;
-    int unknown3;
-
-    // Skip first line (header)
-    std::string str;
-    std::getline(inputFile, str);
-    EV_INFO << "Line " << lineCnt << " skipped (1)" << endl;
-    // Skip second line (home)
-    lineCnt++;
-    std::getline(inputFile, str);
-    EV_INFO << "Line " << lineCnt << " skipped (2)" << endl;
-
-    while (true) {
-        lineCnt++;
-        inputFile >> cmdId >> unknown1 >> unknown2 >> commandType >> p1 >> p2 >> p3 >> p4 >> lat >> lon >> alt >> unknown3;
-
-        if (inputFile.fail()) { //TODO differentiate between EOF and failure
-            EV_INFO << "Line " << lineCnt << " failed (EOF)" << endl;
-            break;
-        }
-        //EV_INFO << "Line " << lineCnt << " okay" << endl;
+    auto pending = std::find_if(pendingReplacements.begin(), pendingReplacements.end(), [&replData](const ReplacementData& other) {
+        return other.nodeToReplace == replData.nodeToReplace;
+    });
+    if (pending != pendingReplacements.end()) {
+        *pending = replData;
+    }
+    else {
+        pendingReplacements.push_back(replData);
+    }
+    if (not assignReplacementsMsg->isScheduled()) {
+        scheduleAt(simTime() + replacementBatchWindow, assignReplacementsMsg);
+    }
+}
 
-        switch (commandType) {
-            case 16: { // WAYPOINT
-                commands.push_back(new WaypointCommand(OsgEarthScene::getInstance()->toX(lon), OsgEarthScene::getInstance()->toY(lat), alt));
-                EV_DEBUG << "WaypointCommand(" << OsgEarthScene::getInstance()->toX(lon) << ", " << OsgEarthScene::getInstance()->toY(lat) << ", " << alt << ")"
-                        << endl;
-                break;
-            }
-            case 17: { // LOITER_UNLIM
-                throw cRuntimeError("loadCommandsFromWaypointsFile(): Command not implemented yet: LOITER_UNLIM");
-                break;
-            }
-            case 19: { // LOITER_TIME
-                commands.push_back(new HoldPositionCommand(OsgEarthScene::getInstance()->toX(lon), OsgEarthScene::getInstance()->toY(lat), alt, p1));
-                EV_DEBUG << "HoldPositionCommand(" << OsgEarthScene::getInstance()->toX(lon) << ", " << OsgEarthScene::getInstance()->toY(lat) << ", " << alt
-                        << ", " << p1 << ")" << endl;
-                break;
-            }
-            case 20: { // RETURN_TO_LAUNCH
-                throw cRuntimeError("loadCommandsFromWaypointsFile(): Command not implemented yet: RETURN_TO_LAUNCH");
-                break;
-            }
-            case 21: { // LAND
-                throw cRuntimeError("loadCommandsFromWaypointsFile(): Command not implemented yet: LAND");
-                break;
-            }
-            case 22: { // TAKEOFF
-                commands.push_back(new TakeoffCommand(alt));
-                EV_DEBUG << "TakeoffCommand(" << alt << ")" << endl;
-                break;
-            }
-            default: {
-                throw cRuntimeError("loadCommandsFromWaypointsFile(): Unexpected file content.");
-                break;
-            }
+/**
+ * Assign all collected replacement requests at once to the nodes available for missions (IDLE or CHARGING).
+ * Minimizes the sum over all requests of the negated remaining battery at the replacement location (see ManagedNodeShadows::scoreCandidates())
+ * plus replacementLatenessCost per second a node would arrive after the replacement time.
+ * Requests without a node that arrives with charge left stay pending for the next batch.
+ */
+void MissionControl::assignReplacements()
+{
+    size_t requests = pendingReplacements.size();
+    for (size_t r = 0; r < requests; r++) {
+        const ReplacementData& replData = pendingReplacements[r];
+        managedNodeShadows.scoreCandidates(replData.x, replData.y, replData.z, replData.timeOfReplacement);
+        if (r == 0) {
+            batchCandidates = managedNodeShadows.getScoredCandidates();
+            assignmentCosts.resize(requests * batchCandidates.size());
+        }
+        // the cost columns of all rows follow the candidates of the first row: no status changes within the batch,
+        // candidates in node index order (see ManagedNodeShadows::collectAvailable())
+        ASSERT(managedNodeShadows.getScoredCandidates() == batchCandidates);
+        const std::vector<double>& remainingAtReplacement = managedNodeShadows.getScoredRemainingAtReplacement();
+        const std::vector<double>& flightDurations = managedNodeShadows.getScoredFlightDurations();
+        double* costs = assignmentCosts.data() + r * batchCandidates.size();
+        for (size_t c = 0; c < batchCandidates.size(); c++) {
+            double lateness = std::max((simTime() + flightDurations[c] - replData.timeOfReplacement).dbl(), 0.0);
+            costs[c] = (remainingAtReplacement[c] > 0) ? replacementLatenessCost * lateness - remainingAtReplacement[c] : INFEASIBLE_ASSIGNMENT_COST;
         }
     }
-    return commands;
+    auto solveStart = std::chrono::steady_clock::now();
+    assignmentSolver.solve(assignmentCosts, requests, batchCandidates.size(), assignment);
+    double solveTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - solveStart).count();
+
+    replacementBatches++;
+    replacementBatchMaxRequests = std::max(replacementBatchMaxRequests, (long) requests);
+    replacementBatchMaxCandidates = std::max(replacementBatchMaxCandidates, (long) batchCandidates.size());
+    replacementBatchSolveTime += solveTime;
+    EV_DETAIL << __func__ << "(): " << requests << " x " << batchCandidates.size() << " assignment solved in " << solveTime << "s" << endl;
+
+    std::vector<ReplacementData> assigned;
+    std::vector<ReplacementData> unassigned;
+    for (size_t r = 0; r < requests; r++) {
+        ReplacementData& replData = pendingReplacements[r];
+        long c = assignment[r];
+        if (c < 0 || assignmentCosts[r * batchCandidates.size() + c] >= INFEASIBLE_ASSIGNMENT_COST) {
+            unassigned.push_back(replData);
+            continue;
+        }
+        // Assign as replacing node to this node
+        NodeShadow* nodeShadow = managedNodeShadows.get(replData.nodeToReplace);
+        batchCandidates[c]->setStatus(NodeStatus::RESERVED);
+        nodeShadow->setReplacementData(new ReplacementData(replData));
+        nodeShadow->setReplacingNode(batchCandidates[c]->getNode());
+        assigned.push_back(replData);
+
+        EV_INFO << __func__ << "(): " << nodeShadow->getNode()->getFullName() << ":";
+        EV_INFO << " node " << nodeShadow->getReplacingNode()->getFullName() << " reserved for replacement" << endl;
+    }
+    pendingReplacements.swap(unassigned);
+
+    // with their replacing node set, the requests are scheduled right away
+    for (const ReplacementData& replData : assigned) {
+        handleReplacementMessage(replData);
+    }
+
+    if (not pendingReplacements.empty()) {
+        EV_WARN << __func__ << "(): no node available for " << pendingReplacements.size() << " replacement(s), retrying in " << replacementBatchWindow
+                << " seconds" << endl;
+        scheduleAt(simTime() + replacementBatchWindow, assignReplacementsMsg);
+    }
 }
 
-void MissionControl::requestChargedNodesInformation(double remainingBattery)
+/**
+ * Subscribe to the charging updates of all ChargingStations.
+ * Each station pushes the nodes at it whose spot or charge changed noticeably, at most once per simulation instant.
+ */
+void MissionControl::subscribeChargingUpdates()
 {
-    // Send request to all ChargingStations
     cModule *network = cSimulation::getActiveSimulation()->getSystemModule();
     for (SubmoduleIterator it(network); !it.end(); ++it) {
         cModule *module = *it;
         if (not module->isName("cs")) {
             continue;
         }
-        MobileNodeRequest *mnRequest = new MobileNodeRequest("mobileNodeRequest");
-        mnRequest->setRemaining(remainingBattery);
-        send(mnRequest, getOutputGateTo(module));
+        send(new cMessage("subscribeChargingUpdates"), getOutputGateTo(module));
     }
 }
 
@@ -19,6 +19,7 @@
 #include <omnetpp.h>
 
 #include <deque>
+#include <vector>
 
 #include "OsgEarthScene.h"
 #include "Command.h"
@@ -32,6 +33,8 @@
 #include "msgs/MobileNodeRequest_m.h"
 #include "msgs/MobileNodeResponse_m.h"
 #include "MissionControlDataMap.h"
+#include "AssignmentSolver.h"
+#include "MissionLoader.h"
 
 using namespace omnetpp;
 
@@ -41,14 +44,35 @@ using namespace omnetpp;
 class MissionControl : public cSimpleModule {
 private:
     ManagedNodeShadows managedNodeShadows;
-    std::deque<CommandQueue> missionQueue;
+    /// Missions, compiled once and shared with the nodes flying them
+    std::deque<MissionProgramHandle> missionQueue;
+
+    /// Replacement requests collected for the next batch assignment, see assignReplacements()
+    std::vector<ReplacementData> pendingReplacements;
+    cMessage *assignReplacementsMsg = nullptr;
+    simtime_t replacementBatchWindow;
+    double replacementLatenessCost;
+    AssignmentSolver assignmentSolver;
+    /// Scratch space of assignReplacements()
+    std::vector<NodeShadow*> batchCandidates;
+    std::vector<double> assignmentCosts;
+    std::vector<long> assignment;
+
+    long replacementBatches = 0;
+    long replacementBatchMaxRequests = 0;
+    long replacementBatchMaxCandidates = 0;
+    /// Wall-clock time of the solver [s], shown and logged but not recorded (not reproducible)
+    double replacementBatchSolveTime = 0;
+public:
+    virtual ~MissionControl();
 protected:
     virtual void initialize() override;
     virtual void finish() override;
     virtual void handleMessage(cMessage *msg) override;
-    virtual CommandQueue loadCommandsFromWaypointsFile(const char *fileName);
     virtual void handleReplacementMessage(ReplacementData replData);
-    virtual void requestChargedNodesInformation(double remainingBattery);
+    virtual void queueReplacement(const ReplacementData& replData);
+    virtual void assignReplacements();
+    virtual void subscribeChargingUpdates();
     virtual cGate* getOutputGateTo(cModule *cMod);
 };
 
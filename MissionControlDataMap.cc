@@ -1,329 +1,611 @@
-//
-// This program is free software: you can redistribute it and/or modify
-// it under the terms of the GNU Lesser General Public License as published by
-// the Free Software Foundation, either version 3 of the License, or
-// (at your option) any later version.
-//
-// This program is distributed in the hope that it will be useful,
-// but WITHOUT ANY WARRANTY; without even the implied warranty of
-// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-// GNU Lesser General Public License for more details.
-//
-// You should have received a copy of the GNU Lesser General Public License
-// along with this program.  If not, see http://www.gnu.org/licenses/.
-//
-
-#include "MissionControlDataMap.h"
-#include <omnetpp.h>
-
-NodeShadow::NodeShadow(GenericNode* node)
-{
-    this->node = node;
-    this->index = node->getIndex();
-}
-
-NodeShadow::~NodeShadow()
-{
-    delete knownBattery;
-}
-
-void NodeShadow::setReplacementData(ReplacementData* replacementData)
-{
-    if (this->replacementData != nullptr) delete this->replacementData;
-    this->replacementData = replacementData;
-}
-
-void NodeShadow::setReplacementMsg(cMessage* replacementMsg)
-{
-    this->replacementMsg = replacementMsg;
-}
-
-void NodeShadow::setStatus(NodeStatus status)
-{
-    if (this->status != status) {
-        switch (this->status) {
-            case NodeStatus::DEAD:
-                EV_WARN << "No status change from DEAD possible!!!";
-                break;
-            case NodeStatus::IDLE:
-                if (NodeStatus::RESERVED == status) {
-                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
-                            << getStatusString(status) << endl;
-                    this->status = status;
-                }
-                else if (NodeStatus::CHARGING == status) {
-                    EV_TRACE << "Status change from " << this->getStatusString() << " to " << getStatusString(status)
-                            << " ignored (probably a delayed message from charging node)." << endl;
-                }
-                else {
-                    EV_WARN << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
-                }
-                break;
-            case NodeStatus::RESERVED:
-                if (NodeStatus::PROVISIONING == status) {
-                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
-                            << getStatusString(status) << endl;
-                    this->status = status;
-                }
-                else if (NodeStatus::CHARGING == status) {
-                    EV_TRACE << "Status change from " << this->getStatusString() << " to " << getStatusString(status)
-                            << " ignored (probably a delayed message from charging node)." << endl;
-                }
-                else {
-                    EV_ERROR << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
-                }
-                break;
-            case NodeStatus::PROVISIONING:
-                if (NodeStatus::MISSION == status) {
-                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
-                            << getStatusString(status) << endl;
-                    this->status = status;
-                }
-                else if (NodeStatus::CHARGING == status) {
-                    EV_TRACE << "Status change from " << this->getStatusString() << " to " << getStatusString(status)
-                            << " ignored (probably a delayed message from charging node)." << endl;
-                }
-                else {
-                    EV_ERROR << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
-                }
-                break;
-            case NodeStatus::MISSION:
-                if (NodeStatus::MAINTENANCE == status) {
-                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
-                            << getStatusString(status) << endl;
-                    this->status = status;
-                }
-                else if (NodeStatus::CHARGING == status) {
-                    EV_TRACE << "Status change from " << this->getStatusString() << " to " << getStatusString(status)
-                            << " ignored (probably a delayed message from charging node)." << endl;
-                }
-                else {
-                    EV_ERROR << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
-                }
-                break;
-            case NodeStatus::MAINTENANCE:
-                if (NodeStatus::CHARGING == status) {
-                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
-                            << getStatusString(status) << endl;
-                    this->status = status;
-                }
-                else {
-                    EV_ERROR << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
-                }
-                break;
-            case NodeStatus::CHARGING:
-                if (NodeStatus::IDLE == status || NodeStatus::RESERVED == status) {
-                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
-                            << getStatusString(status) << endl;
-                    this->status = status;
-                }
-                else {
-                    EV_ERROR << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
-                }
-                break;
-            default:
-                throw cRuntimeError("Unknown node status");
-        }
-    }
-}
-
-void NodeShadow::setReplacingNode(GenericNode* replacingNode)
-{
-    if (not hasReplacementData()) throw cRuntimeError("No replacementData available, this method should not be called here");
-    this->replacementData->replacingNode = replacingNode;
-}
-
-void NodeShadow::clearReplacementMsg()
-{
-    this->replacementMsg = nullptr;
-}
-
-void NodeShadow::clearReplacementData()
-{
-    if (hasReplacementData()) delete this->replacementData;
-    this->replacementData = nullptr;
-}
-
-void NodeShadow::clearReplacementNode()
-{
-    if (hasReplacementData()) this->replacementData->replacingNode = nullptr;
-}
-
-/**
- *
- */
-ManagedNodeShadows::ManagedNodeShadows()
-{
-}
-
-ManagedNodeShadows::~ManagedNodeShadows()
-{
-}
-
-bool ManagedNodeShadows::has(int index)
-{
-    return not (managedNodes.find(index) == managedNodes.end());
-}
-
-void ManagedNodeShadows::add(NodeShadow* nodeShadow)
-{
-    int index = nodeShadow->getNodeIndex();
-    if (has(index)) throw cRuntimeError("addNode(): Node with index already exists in map.");
-    std::pair<int, NodeShadow*> nodePair(index, nodeShadow);
-    managedNodes.insert(nodePair);
-}
-
-void ManagedNodeShadows::remove(int index)
-{
-    if (has(index)) managedNodes.erase(index);
-}
-
-void ManagedNodeShadows::setStatus(int index, NodeStatus newStatus)
-{
-    get(index)->setStatus(newStatus);
-}
-
-void ManagedNodeShadows::setStatus(GenericNode* node, NodeStatus newStatus)
-{
-    get(node)->setStatus(newStatus);
-}
-
-NodeShadow* ManagedNodeShadows::get(int index)
-{
-    if (not has(index)) throw cRuntimeError("getNode(): Node with index doesn't exists in map.");
-    return managedNodes.at(index);
-}
-
-NodeShadow* ManagedNodeShadows::get(GenericNode* node)
-{
-    int index = node->getIndex();
-    return get(index);
-}
-
-/**
- * Choose a free node from the managedNodes map that is closest to the given coordinates.
- * Selection happens by comparing all available notes with the given status and their distance to the given coordinates.
- */
-NodeShadow* ManagedNodeShadows::getClosest(NodeStatus requestedStatus, float x, float y, float z)
-{
-    std::vector<NodeShadow*> candidates;
-    double shortestDistance = DBL_MAX;
-    for (auto it = managedNodes.begin(); it != managedNodes.end(); ++it) {
-        double distance = sqrt(
-                pow(it->second->getNode()->getX() - x, 2) + pow(it->second->getNode()->getY() - y, 2) + pow(it->second->getNode()->getZ() - z, 2));
-        if (it->second->isStatus(requestedStatus)) {
-            if (distance < shortestDistance) {
-                // new shortest distance
-                candidates.clear();
-                shortestDistance = distance;
-            }
-            if (distance == shortestDistance) {
-                candidates.push_back(it->second);
-            }
-        }
-    }
-    if (candidates.empty()) return nullptr;
-
-    unsigned int theChosenIndex = getEnvir()->getRNG(0)->intRand(candidates.size());
-    return candidates.at(theChosenIndex);
-}
-
-/**
- * Choose a free node from the managedNodes map.
- * Selection happens by lowest module index and amongst the nodes of a certain status.
- */
-NodeShadow* ManagedNodeShadows::getFirst(NodeStatus currentStatus)
-{
-    for (auto it = managedNodes.begin(); it != managedNodes.end(); ++it) {
-        if (it->second->isStatus(currentStatus)) {
-            return it->second;
-        }
-    }
-//    throw cRuntimeError("getNode(): No available Nodes found. This case is not handled yet.");
-    return nullptr;
-
-}
-
-/**
- * Get the node with the highest charge that is available for missions.
- */
-NodeShadow* ManagedNodeShadows::getHighestCharged()
-{
-    NodeShadow* highestChargedNode = nullptr;
-    for (auto it = managedNodes.begin(); it != managedNodes.end(); ++it) {
-        if (not (it->second->isStatusCharging() || it->second->isStatusIdle())) {
-            continue;
-        }
-
-        Battery* tempKnownBattery = it->second->getKnownBattery();
-        if (tempKnownBattery == nullptr) {
-            continue;
-        }
-
-        if (highestChargedNode == nullptr) {
-            highestChargedNode = it->second;
-        }
-        else if (highestChargedNode->getKnownBattery()->getRemainingPercentage() <= tempKnownBattery->getRemainingPercentage()) {
-            highestChargedNode = it->second;
-        }
-    }
-    return highestChargedNode;
-}
-
-/**
- * Returns the node with the highest charge after the flight to the given coordinates that is available for missions.
- */
-NodeShadow* ManagedNodeShadows::getHighestChargeAtReplacement(float destX, float destY, float destZ)
-{
-    std::vector<NodeShadow*> candidates;
-    double maxRemainingAtRepl = 0; // remaining battery after flight to exchange
-    for (auto it = managedNodes.cbegin(); it != managedNodes.cend(); ++it) {
-        if (not (it->second->isStatusCharging() || it->second->isStatusIdle())) {
-                continue;
-        }
-
-        UAVNode* node = (UAVNode*) it->second->getNode();
-        Battery* tempKnownBattery = it->second->getKnownBattery();
-
-        //TODO: Inaccurate workaround
-        double fullBatteryCapacity = 5200;
-        double remaining = (tempKnownBattery != nullptr) ? tempKnownBattery->getRemaining() : fullBatteryCapacity;
-        if (tempKnownBattery == nullptr) {
-            EV_WARN << "Defaulting to a full battery during replacement candidate selection. " //
-                    << "This should only be seen in the beginning of a simulation!" << endl;
-        }
-
-        WaypointCommand waypointCmd = WaypointCommand(destX, destY, destZ);
-        WaypointCEE waypointCEE = WaypointCEE(node, &waypointCmd);
-        waypointCEE.initializeCEE();
-        double consumption = waypointCEE.predictFullConsumptionQuantile();
-        double remainingAtRepl = remaining - consumption;
-
-        if (remainingAtRepl > maxRemainingAtRepl) {
-            // new shortest distance
-            candidates.clear();
-            maxRemainingAtRepl = remainingAtRepl;
-        }
-
-        float tolerance = 1.0;
-        if (fabs(remainingAtRepl - maxRemainingAtRepl) < tolerance) {
-            candidates.push_back(it->second);
-        }
-    }
-
-    ASSERT(not candidates.empty());
-
-    unsigned int theRandomIndex = getEnvir()->getRNG(0)->intRand(candidates.size());
-    return candidates.at(theRandomIndex);
-}
-
-NodeShadow* ManagedNodeShadows::getNodeRequestingReplacement(cMessage* msg)
-{
-    for (auto it = managedNodes.begin(); it != managedNodes.end(); ++it) {
-        if (it->second->compareReplacementMsg(msg)) {
-            return it->second;
-        }
-    }
-    throw cRuntimeError("getNodeRequestingReplacement(): Message not found amongst the managed nodes.");
-    return nullptr;
-}
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "MissionControlDataMap.h"
+#include <algorithm>
+#include <omnetpp.h>
+#include "UAVNode.h"
+#include "ChargingNode.h"
+#include "ChargingNodeRegistry.h"
+
+constexpr int ManagedNodeShadows::STATUS_COUNT;
+
+/// Edge length of the cubic cells of the spatial index, in [m]
+#define SPATIAL_CELL_SIZE 25.0
+
+NodeShadow::NodeShadow(GenericNode* node)
+{
+    this->node = node;
+    this->index = node->getIndex();
+}
+
+NodeShadow::~NodeShadow()
+{
+}
+
+void NodeShadow::setReplacementData(ReplacementData* replacementData)
+{
+    if (this->replacementData != nullptr) delete this->replacementData;
+    this->replacementData = replacementData;
+}
+
+void NodeShadow::setReplacementMsg(cMessage* replacementMsg)
+{
+    if (owner != nullptr) {
+        if (this->replacementMsg != nullptr) owner->replacementMsgOwners.erase(this->replacementMsg);
+        if (replacementMsg != nullptr) owner->replacementMsgOwners[replacementMsg] = this;
+    }
+    this->replacementMsg = replacementMsg;
+}
+
+void NodeShadow::setStatus(NodeStatus status)
+{
+    if (this->status != status) {
+        switch (this->status) {
+            case NodeStatus::DEAD:
+                EV_WARN << "No status change from DEAD possible!!!";
+                break;
+            case NodeStatus::IDLE:
+                if (NodeStatus::RESERVED == status) {
+                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
+                            << getStatusString(status) << endl;
+                    changeStatus(status);
+                }
+                else if (NodeStatus::CHARGING == status) {
+                    EV_TRACE << "Status change from " << this->getStatusString() << " to " << getStatusString(status)
+                            << " ignored (probably a delayed message from charging node)." << endl;
+                }
+                else {
+                    EV_WARN << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
+                }
+                break;
+            case NodeStatus::RESERVED:
+                if (NodeStatus::PROVISIONING == status) {
+                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
+                            << getStatusString(status) << endl;
+                    changeStatus(status);
+                }
+                else if (NodeStatus::CHARGING == status) {
+                    EV_TRACE << "Status change from " << this->getStatusString() << " to " << getStatusString(status)
+                            << " ignored (probably a delayed message from charging node)." << endl;
+                }
+                else {
+                    EV_ERROR << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
+                }
+                break;
+            case NodeStatus::PROVISIONING:
+                if (NodeStatus::MISSION == status) {
+                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
+                            << getStatusString(status) << endl;
+                    changeStatus(status);
+                }
+                else if (NodeStatus::CHARGING == status) {
+                    EV_TRACE << "Status change from " << this->getStatusString() << " to " << getStatusString(status)
+                            << " ignored (probably a delayed message from charging node)." << endl;
+                }
+                else {
+                    EV_ERROR << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
+                }
+                break;
+            case NodeStatus::MISSION:
+                if (NodeStatus::MAINTENANCE == status) {
+                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
+                            << getStatusString(status) << endl;
+                    changeStatus(status);
+                }
+                else if (NodeStatus::CHARGING == status) {
+                    EV_TRACE << "Status change from " << this->getStatusString() << " to " << getStatusString(status)
+                            << " ignored (probably a delayed message from charging node)." << endl;
+                }
+                else {
+                    EV_ERROR << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
+                }
+                break;
+            case NodeStatus::MAINTENANCE:
+                if (NodeStatus::CHARGING == status) {
+                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
+                            << getStatusString(status) << endl;
+                    changeStatus(status);
+                }
+                else {
+                    EV_ERROR << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
+                }
+                break;
+            case NodeStatus::CHARGING:
+                if (NodeStatus::IDLE == status || NodeStatus::RESERVED == status) {
+                    EV_INFO << "Changing node shadow " << getNode()->getFullName() << " from status " << this->getStatusString() << " to "
+                            << getStatusString(status) << endl;
+                    changeStatus(status);
+                }
+                else {
+                    EV_ERROR << "No status change from " << this->getStatusString() << " to " << getStatusString(status) << " possible!!!" << endl;
+                }
+                break;
+            default:
+                throw cRuntimeError("Unknown node status");
+        }
+    }
+}
+
+/**
+ * Set the status and move the node into the matching status list of its owner.
+ */
+void NodeShadow::changeStatus(NodeStatus status)
+{
+    if (owner != nullptr) owner->unlink(this);
+    this->status = status;
+    if (owner != nullptr) owner->link(this);
+}
+
+void NodeShadow::setReplacingNode(GenericNode* replacingNode)
+{
+    if (not hasReplacementData()) throw cRuntimeError("No replacementData available, this method should not be called here");
+    this->replacementData->replacingNode = replacingNode;
+}
+
+void NodeShadow::clearReplacementMsg()
+{
+    setReplacementMsg(nullptr);
+}
+
+void NodeShadow::clearReplacementData()
+{
+    if (hasReplacementData()) delete this->replacementData;
+    this->replacementData = nullptr;
+}
+
+void NodeShadow::clearReplacementNode()
+{
+    if (hasReplacementData()) this->replacementData->replacingNode = nullptr;
+}
+
+/**
+ *
+ */
+ManagedNodeShadows::ManagedNodeShadows()
+{
+}
+
+ManagedNodeShadows::~ManagedNodeShadows()
+{
+}
+
+bool ManagedNodeShadows::has(int index)
+{
+    return index >= 0 && index < (int) managedNodes.size() && managedNodes[index] != nullptr;
+}
+
+void ManagedNodeShadows::add(NodeShadow* nodeShadow)
+{
+    int index = nodeShadow->getNodeIndex();
+    if (has(index)) throw cRuntimeError("addNode(): Node with index already exists in map.");
+    if (index >= (int) managedNodes.size()) managedNodes.resize(index + 1, nullptr);
+    managedNodes[index] = nodeShadow;
+    managedCount++;
+    nodeShadow->owner = this;
+    link(nodeShadow);
+    if (nodeShadow->hasReplacementMsg()) replacementMsgOwners[nodeShadow->replacementMsg] = nodeShadow;
+}
+
+void ManagedNodeShadows::remove(int index)
+{
+    if (not has(index)) return;
+    NodeShadow* nodeShadow = managedNodes[index];
+    unlink(nodeShadow);
+    if (nodeShadow->hasReplacementMsg()) replacementMsgOwners.erase(nodeShadow->replacementMsg);
+    nodeShadow->owner = nullptr;
+    managedNodes[index] = nullptr;
+    managedCount--;
+}
+
+/**
+ * Insert the node into the list of its status, behind all nodes with a lower index.
+ */
+void ManagedNodeShadows::link(NodeShadow* nodeShadow)
+{
+    int status = (int) nodeShadow->status;
+    NodeShadow* prev = nullptr;
+    NodeShadow* next = statusLists[status];
+    while (next != nullptr && next->index < nodeShadow->index) {
+        prev = next;
+        next = next->statusNext;
+    }
+    nodeShadow->statusPrev = prev;
+    nodeShadow->statusNext = next;
+    if (prev != nullptr)
+        prev->statusNext = nodeShadow;
+    else
+        statusLists[status] = nodeShadow;
+    if (next != nullptr) next->statusPrev = nodeShadow;
+    statusCounts[status]++;
+    if (isIndexed(nodeShadow->status)) addToIndex(nodeShadow);
+}
+
+void ManagedNodeShadows::unlink(NodeShadow* nodeShadow)
+{
+    int status = (int) nodeShadow->status;
+    if (nodeShadow->statusPrev != nullptr)
+        nodeShadow->statusPrev->statusNext = nodeShadow->statusNext;
+    else
+        statusLists[status] = nodeShadow->statusNext;
+    if (nodeShadow->statusNext != nullptr) nodeShadow->statusNext->statusPrev = nodeShadow->statusPrev;
+    nodeShadow->statusPrev = nullptr;
+    nodeShadow->statusNext = nullptr;
+    statusCounts[status]--;
+    if (nodeShadow->indexedBucket >= 0) removeFromIndex(nodeShadow);
+}
+
+/**
+ * Put the node into the bucket of its current position, in the spatial index of its status.
+ */
+void ManagedNodeShadows::addToIndex(NodeShadow* nodeShadow)
+{
+    SpatialIndex& spatialIndex = spatialIndexes[(int) nodeShadow->status];
+    nodeShadow->indexedX = nodeShadow->getNode()->getX();
+    nodeShadow->indexedY = nodeShadow->getNode()->getY();
+    nodeShadow->indexedZ = nodeShadow->getNode()->getZ();
+    long cellX = (long) floor(nodeShadow->indexedX / SPATIAL_CELL_SIZE);
+    long cellY = (long) floor(nodeShadow->indexedY / SPATIAL_CELL_SIZE);
+    long cellZ = (long) floor(nodeShadow->indexedZ / SPATIAL_CELL_SIZE);
+    int64_t cell = ((int64_t) (cellX & 0x1FFFFF) << 42) | ((int64_t) (cellY & 0x1FFFFF) << 21) | (int64_t) (cellZ & 0x1FFFFF);
+
+    auto it = spatialIndex.bucketOfCell.find(cell);
+    if (it == spatialIndex.bucketOfCell.end()) {
+        it = spatialIndex.bucketOfCell.insert(std::make_pair(cell, spatialIndex.buckets.size())).first;
+        spatialIndex.buckets.push_back(SpatialBucket { cellX, cellY, cellZ, std::vector<NodeShadow*>() });
+    }
+    spatialIndex.buckets[it->second].nodes.push_back(nodeShadow);
+    nodeShadow->indexedBucket = it->second;
+}
+
+void ManagedNodeShadows::removeFromIndex(NodeShadow* nodeShadow)
+{
+    // buckets are kept when empty, the number of occupied cells is small
+    std::vector<NodeShadow*>& nodes = spatialIndexes[(int) nodeShadow->status].buckets[nodeShadow->indexedBucket].nodes;
+    nodes.erase(std::find(nodes.begin(), nodes.end(), nodeShadow));
+    nodeShadow->indexedBucket = -1;
+}
+
+/**
+ * Refresh the position of the node in the spatial index, e.g. after it arrived at a charging node.
+ */
+void ManagedNodeShadows::updatePosition(NodeShadow* nodeShadow)
+{
+    if (nodeShadow->indexedBucket < 0) return;
+    GenericNode* node = nodeShadow->getNode();
+    if (node->getX() == nodeShadow->indexedX && node->getY() == nodeShadow->indexedY && node->getZ() == nodeShadow->indexedZ) return;
+    removeFromIndex(nodeShadow);
+    addToIndex(nodeShadow);
+}
+
+void ManagedNodeShadows::updatePositions()
+{
+    for (NodeShadow* nodeShadow : managedNodes) {
+        if (nodeShadow != nullptr) updatePosition(nodeShadow);
+    }
+}
+
+/**
+ * Merge the IDLE and CHARGING lists into availableNodes, in node index order.
+ */
+void ManagedNodeShadows::collectAvailable()
+{
+    availableNodes.clear();
+    NodeShadow* idle = statusLists[(int) NodeStatus::IDLE];
+    NodeShadow* charging = statusLists[(int) NodeStatus::CHARGING];
+    while (idle != nullptr || charging != nullptr) {
+        if (charging == nullptr || (idle != nullptr && idle->index < charging->index)) {
+            availableNodes.push_back(idle);
+            idle = idle->statusNext;
+        }
+        else {
+            availableNodes.push_back(charging);
+            charging = charging->statusNext;
+        }
+    }
+}
+
+void ManagedNodeShadows::setStatus(int index, NodeStatus newStatus)
+{
+    get(index)->setStatus(newStatus);
+}
+
+void ManagedNodeShadows::setStatus(GenericNode* node, NodeStatus newStatus)
+{
+    get(node)->setStatus(newStatus);
+}
+
+NodeShadow* ManagedNodeShadows::get(int index)
+{
+    if (not has(index)) throw cRuntimeError("getNode(): Node with index doesn't exists in map.");
+    return managedNodes[index];
+}
+
+NodeShadow* ManagedNodeShadows::get(GenericNode* node)
+{
+    int index = node->getIndex();
+    return get(index);
+}
+
+/**
+ * Choose a free node from the managedNodes map that is closest to the given coordinates.
+ * Selection happens by comparing all nodes with the given status and their distance to the given coordinates.
+ */
+NodeShadow* ManagedNodeShadows::getClosest(NodeStatus requestedStatus, float x, float y, float z)
+{
+    if (isIndexed(requestedStatus)) {
+        return getClosestIndexed(requestedStatus, x, y, z);
+    }
+
+    std::vector<NodeShadow*> candidates;
+    double shortestDistance = DBL_MAX;
+    for (NodeShadow* it = statusLists[(int) requestedStatus]; it != nullptr; it = it->statusNext) {
+        double distance = sqrt(pow(it->getNode()->getX() - x, 2) + pow(it->getNode()->getY() - y, 2) + pow(it->getNode()->getZ() - z, 2));
+        if (distance < shortestDistance) {
+            // new shortest distance
+            candidates.clear();
+            shortestDistance = distance;
+        }
+        if (distance == shortestDistance) {
+            candidates.push_back(it);
+        }
+    }
+    if (candidates.empty()) return nullptr;
+
+    unsigned int theChosenIndex = getEnvir()->getRNG(0)->intRand(candidates.size());
+    return candidates.at(theChosenIndex);
+}
+
+/**
+ * getClosest() on the spatial index: buckets are visited by increasing distance of their cell
+ * until the cell is farther away than the closest node found so far.
+ * Distances and the random choice amongst equally close nodes (in node index order) are the same as of the list scan.
+ */
+NodeShadow* ManagedNodeShadows::getClosestIndexed(NodeStatus requestedStatus, double x, double y, double z)
+{
+    SpatialIndex& spatialIndex = spatialIndexes[(int) requestedStatus];
+    bucketOrder.clear();
+    for (size_t bucket = 0; bucket < spatialIndex.buckets.size(); bucket++) {
+        const SpatialBucket& spatialBucket = spatialIndex.buckets[bucket];
+        if (spatialBucket.nodes.empty()) continue;
+        double lowerX = spatialBucket.cellX * SPATIAL_CELL_SIZE, lowerY = spatialBucket.cellY * SPATIAL_CELL_SIZE, lowerZ = spatialBucket.cellZ
+                * SPATIAL_CELL_SIZE;
+        double dx = std::max(std::max(lowerX - x, x - (lowerX + SPATIAL_CELL_SIZE)), 0.0);
+        double dy = std::max(std::max(lowerY - y, y - (lowerY + SPATIAL_CELL_SIZE)), 0.0);
+        double dz = std::max(std::max(lowerZ - z, z - (lowerZ + SPATIAL_CELL_SIZE)), 0.0);
+        bucketOrder.push_back(std::make_pair(sqrt(dx * dx + dy * dy + dz * dz), bucket));
+    }
+    std::sort(bucketOrder.begin(), bucketOrder.end());
+
+    std::vector<NodeShadow*> candidates;
+    double shortestDistance = DBL_MAX;
+    for (auto& entry : bucketOrder) {
+        // strictly farther only, equally close nodes are candidates as well
+        if (entry.first > shortestDistance) break;
+        for (NodeShadow* it : spatialIndex.buckets[entry.second].nodes) {
+            double distance = sqrt(pow(it->getNode()->getX() - x, 2) + pow(it->getNode()->getY() - y, 2) + pow(it->getNode()->getZ() - z, 2));
+            if (distance < shortestDistance) {
+                // new shortest distance
+                candidates.clear();
+                shortestDistance = distance;
+            }
+            if (distance == shortestDistance) {
+                candidates.push_back(it);
+            }
+        }
+    }
+    if (candidates.empty()) return nullptr;
+
+    std::sort(candidates.begin(), candidates.end(), [](const NodeShadow* a, const NodeShadow* b) {
+        return a->getNodeIndex() < b->getNodeIndex();
+    });
+    unsigned int theChosenIndex = getEnvir()->getRNG(0)->intRand(candidates.size());
+    return candidates.at(theChosenIndex);
+}
+
+/**
+ * Choose a free node from the managedNodes map.
+ * Selection happens by lowest module index and amongst the nodes of a certain status.
+ */
+NodeShadow* ManagedNodeShadows::getFirst(NodeStatus currentStatus)
+{
+    NodeShadow* first = statusLists[(int) currentStatus];
+    if (first != nullptr) {
+        return first;
+    }
+//    throw cRuntimeError("getNode(): No available Nodes found. This case is not handled yet.");
+    return nullptr;
+
+}
+
+/**
+ * Get the node with the highest charge that is available for missions.
+ */
+NodeShadow* ManagedNodeShadows::getHighestCharged()
+{
+    NodeShadow* highestChargedNode = nullptr;
+    collectAvailable();
+    for (NodeShadow* nodeShadow : availableNodes) {
+        if (not nodeShadow->hasKnownBattery()) {
+            continue;
+        }
+
+        if (highestChargedNode == nullptr) {
+            highestChargedNode = nodeShadow;
+        }
+        else if (highestChargedNode->getKnownBattery().getRemainingPercentage() <= nodeShadow->getKnownBattery().getRemainingPercentage()) {
+            highestChargedNode = nodeShadow;
+        }
+    }
+    return highestChargedNode;
+}
+
+/// Step width of the charge prediction in the constant voltage stage, in [s]
+#define CV_PREDICTION_STEP 60.0
+
+/**
+ * Charge gained on the charging curve of the algorithm within the given seconds, in [mAh].
+ * The constant current stage is predicted in one step, the constant voltage stage in steps of CV_PREDICTION_STEP, capped at the capacity.
+ */
+static double predictChargeAmount(IChargeAlgorithm* chargeAlgorithm, double remaining, double capacity, double seconds)
+{
+    if (seconds <= 0 || remaining >= capacity) return 0;
+    double fastChargeRemaining = capacity / 100 * chargeAlgorithm->getFastChargePercentage(capacity);
+    double charged = remaining;
+    if (charged < fastChargeRemaining) {
+        double fastChargeSeconds = chargeAlgorithm->calculateChargeTime(charged, capacity, chargeAlgorithm->getFastChargePercentage(capacity));
+        if (seconds <= fastChargeSeconds) {
+            return std::min(chargeAlgorithm->calculateChargeAmount(charged, capacity, seconds), capacity - remaining);
+        }
+        charged = fastChargeRemaining;
+        seconds -= fastChargeSeconds;
+    }
+    while (seconds > 0 && charged < capacity) {
+        double amount = chargeAlgorithm->calculateChargeAmount(charged, capacity, std::min(seconds, CV_PREDICTION_STEP));
+        if (amount <= 0) break;
+        charged += amount;
+        seconds -= CV_PREDICTION_STEP;
+    }
+    return std::min(charged, capacity) - remaining;
+}
+
+/**
+ * Predict for all nodes available for missions the remaining battery after their flight to the given coordinates.
+ * Charging nodes are credited with the charge they gain until they have to depart (the replacement time minus their flight time).
+ * All candidates are predicted in one pass over a struct of arrays, their flights in one batch if they share their energy model.
+ */
+void ManagedNodeShadows::scoreCandidates(float destX, float destY, float destZ, simtime_t timeOfReplacement)
+{
+    CandidateBatch& batch = candidateBatch;
+    batch.clear();
+    const EnergyModel* sharedModel = nullptr;
+    double sharedQuantileZ = 0;
+    bool modelShared = true;
+    collectAvailable();
+    for (NodeShadow* nodeShadow : availableNodes) {
+        UAVNode* node = (UAVNode*) nodeShadow->getNode();
+
+        //TODO: Inaccurate workaround
+        double fullBatteryCapacity = 5200;
+        IChargeAlgorithm* chargeAlgorithm = nullptr;
+        if (nodeShadow->hasKnownBattery()) {
+            batch.remaining.push_back(nodeShadow->getKnownBattery().getRemaining());
+            batch.capacity.push_back(nodeShadow->getKnownBattery().getCapacity());
+            if (nodeShadow->isStatusCharging()) {
+                ChargingNode* cn = ChargingNodeRegistry::getInstance().findNearest(node->getX(), node->getY(), node->getZ());
+                if (cn != nullptr) chargeAlgorithm = cn->getChargeAlgorithm();
+            }
+        }
+        else {
+            EV_WARN << "Defaulting to a full battery during replacement candidate selection. " //
+                    << "This should only be seen in the beginning of a simulation!" << endl;
+            batch.remaining.push_back(fullBatteryCapacity);
+            batch.capacity.push_back(fullBatteryCapacity);
+        }
+        batch.nodes.push_back(nodeShadow);
+        batch.chargeAlgorithm.push_back(chargeAlgorithm);
+        batch.flights.addMovement(destX - node->getX(), destY - node->getY(), destZ - node->getZ());
+
+        if (sharedModel == nullptr) {
+            sharedModel = &node->getEnergyModel();
+            sharedQuantileZ = node->getQuantileZ();
+        }
+        else if (sharedModel != &node->getEnergyModel() || sharedQuantileZ != node->getQuantileZ()) {
+            modelShared = false;
+        }
+    }
+    size_t count = batch.nodes.size();
+
+    // Flights to the replacement location
+    if (modelShared && sharedModel != nullptr) {
+        sharedModel->predictLegs(batch.flights, sharedQuantileZ, batch.predictions);
+    }
+    else {
+        batch.predictions.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            UAVNode* node = (UAVNode*) batch.nodes[i]->getNode();
+            LegPrediction flight = node->getEnergyModel().predictMovement(batch.flights.dx[i], batch.flights.dy[i], batch.flights.dz[i],
+                    node->getQuantileZ());
+            batch.predictions.energyQuantile[i] = flight.energyQuantile;
+            batch.predictions.duration[i] = flight.duration;
+        }
+    }
+
+    // Charge gained from the last known battery state until departure
+    for (size_t i = 0; i < count; i++) {
+        if (batch.chargeAlgorithm[i] == nullptr) continue;
+        simtime_t departure = std::max(timeOfReplacement - batch.predictions.duration[i], simTime());
+        double seconds = (departure - batch.nodes[i]->getKnownBatteryTime()).dbl();
+        batch.remaining[i] += predictChargeAmount(batch.chargeAlgorithm[i], batch.remaining[i], batch.capacity[i], seconds);
+    }
+
+    // Remaining battery after the flight to the exchange
+    batch.remainingAtReplacement.resize(count);
+    const double* remaining = batch.remaining.data();
+    const double* consumption = batch.predictions.energyQuantile.data();
+    double* remainingAtReplacement = batch.remainingAtReplacement.data();
+    for (size_t i = 0; i < count; i++) {
+        remainingAtReplacement[i] = remaining[i] - consumption[i];
+    }
+}
+
+/**
+ * Returns the node with the highest charge after the flight to the given coordinates that is available for missions, see scoreCandidates().
+ */
+NodeShadow* ManagedNodeShadows::getHighestChargeAtReplacement(float destX, float destY, float destZ, simtime_t timeOfReplacement)
+{
+    scoreCandidates(destX, destY, destZ, timeOfReplacement);
+    const CandidateBatch& batch = candidateBatch;
+    size_t count = batch.nodes.size();
+    std::vector<NodeShadow*> candidates;
+    double maxRemainingAtRepl = 0;
+    for (size_t i = 0; i < count; i++) {
+        NodeShadow* nodeShadow = batch.nodes[i];
+        double remainingAtRepl = batch.remainingAtReplacement[i];
+
+        if (remainingAtRepl > maxRemainingAtRepl) {
+            // new shortest distance
+            candidates.clear();
+            maxRemainingAtRepl = remainingAtRepl;
+        }
+
+        float tolerance = 1.0;
+        if (fabs(remainingAtRepl - maxRemainingAtRepl) < tolerance) {
+            candidates.push_back(nodeShadow);
+        }
+    }
+
+    ASSERT(not candidates.empty());
+
+    unsigned int theRandomIndex = getEnvir()->getRNG(0)->intRand(candidates.size());
+    return candidates.at(theRandomIndex);
+}
+
+/**
+ * Replacement messages carry their NodeShadow as context pointer, with the index of all replacement messages as backup.
+ */
+NodeShadow* ManagedNodeShadows::getNodeRequestingReplacement(cMessage* msg)
+{
+    NodeShadow* nodeShadow = static_cast<NodeShadow*>(msg->getContextPointer());
+    if (nodeShadow != nullptr && nodeShadow->owner == this && nodeShadow->compareReplacementMsg(msg)) {
+        return nodeShadow;
+    }
+    auto it = replacementMsgOwners.find(msg);
+    if (it != replacementMsgOwners.end()) {
+        return it->second;
+    }
+    throw cRuntimeError("getNodeRequestingReplacement(): Message not found amongst the managed nodes.");
+    return nullptr;
+}
@@ -18,11 +18,15 @@
 
 #include <omnetpp.h>
 
-#include <map>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
 
 #include "GenericNode.h"
 #include "ReplacementData.h"
 #include "Battery.h"
+#include "EnergyModel.h"
+#include "IChargeAlgorithm.h"
 
 using namespace omnetpp;
 
@@ -33,17 +37,31 @@ enum class NodeStatus {
     IDLE, RESERVED, PROVISIONING, MISSION, MAINTENANCE, CHARGING, DEAD
 };
 
+class ManagedNodeShadows;
+
 /**
  * A summarized view on a node needed by the MissionControl for node management.
  */
 class NodeShadow {
+    friend class ManagedNodeShadows;
 private:
     int index;
     GenericNode* node;
     NodeStatus status = NodeStatus::IDLE;
     ReplacementData* replacementData = nullptr;
     cMessage* replacementMsg = nullptr;
-    Battery* knownBattery = nullptr;
+    /// Last battery state reported by a charging node, valid if hasKnownBattery()
+    Battery knownBattery;
+    bool knownBatteryValid = false;
+    simtime_t knownBatteryTime;
+    /// Membership in the status list of the owning ManagedNodeShadows, see setStatus()
+    ManagedNodeShadows* owner = nullptr;
+    NodeShadow* statusPrev = nullptr;
+    NodeShadow* statusNext = nullptr;
+    /// Position and bucket in the spatial index of the owner, if the status is indexed
+    double indexedX = 0, indexedY = 0, indexedZ = 0;
+    long indexedBucket = -1;
+    void changeStatus(NodeStatus status);
 public:
     NodeShadow(GenericNode* node);
     virtual ~NodeShadow();
@@ -189,24 +207,102 @@ public:
     void setReplacementMsg(cMessage* replacementMsg);
     void setReplacingNode(GenericNode* replacingNode);
 
-    Battery* getKnownBattery()
+    bool hasKnownBattery() const
+    {
+        return knownBatteryValid;
+    }
+
+    const Battery& getKnownBattery() const
     {
         return knownBattery;
     }
 
-    void setKnownBattery(Battery* knownBattery = nullptr)
+    /**
+     * @return point in time of the last setKnownBattery()
+     */
+    simtime_t getKnownBatteryTime() const
     {
-        if (this->knownBattery != nullptr) delete this->knownBattery;
-        this->knownBattery = knownBattery;
+        return knownBatteryTime;
+    }
+
+    void setKnownBattery(float capacity, float remaining)
+    {
+        knownBattery = Battery(capacity, remaining);
+        knownBatteryValid = true;
+        knownBatteryTime = simTime();
     }
 };
 
 /**
  * A comprising map of all NodeShadow objects needed by the MissionControl for node management.
+ * Nodes are stored densely by node index. Per NodeStatus the nodes are additionally linked into a list in node index order,
+ * maintained by NodeShadow::setStatus(), so queries for a status only visit the nodes in that status.
+ * Nodes in a stationary status (IDLE, CHARGING: waiting at a charging node) are also kept in a spatial index of grid buckets.
+ * Their position is taken when they enter the status and has to be refreshed with updatePosition() when a node may have moved.
  */
 class ManagedNodeShadows {
+    friend class NodeShadow;
 private:
-    std::map<int, NodeShadow*> managedNodes;
+    static constexpr int STATUS_COUNT = (int) NodeStatus::DEAD + 1;
+
+    /// NodeShadow per node index, nullptr if not managed
+    std::vector<NodeShadow*> managedNodes;
+    int managedCount = 0;
+    /// Per NodeStatus: first NodeShadow of the status list and length of the list
+    NodeShadow* statusLists[STATUS_COUNT] = { };
+    int statusCounts[STATUS_COUNT] = { };
+    /// Nodes available for missions (IDLE or CHARGING) in node index order, see collectAvailable()
+    std::vector<NodeShadow*> availableNodes;
+
+    /// Spatial index per stationary status: nodes by grid cell, occupied cells are few (the charging nodes)
+    struct SpatialBucket {
+        long cellX, cellY, cellZ;
+        std::vector<NodeShadow*> nodes;
+    };
+    struct SpatialIndex {
+        std::unordered_map<int64_t, size_t> bucketOfCell;
+        std::vector<SpatialBucket> buckets;
+    };
+    SpatialIndex spatialIndexes[STATUS_COUNT];
+    /// Scratch space of getClosest(): lower bound of the distance and bucket
+    std::vector<std::pair<double, size_t>> bucketOrder;
+    /// Scratch space of scoreCandidates(): the candidates as struct of arrays, one entry per candidate
+    struct CandidateBatch {
+        std::vector<NodeShadow*> nodes;
+        /// known (or assumed) battery, in [mAh]
+        std::vector<double> remaining;
+        std::vector<double> capacity;
+        /// charge algorithm of the charging node of a charging candidate, nullptr otherwise
+        std::vector<IChargeAlgorithm*> chargeAlgorithm;
+        /// flight to the replacement location
+        LegBatch flights;
+        LegPredictions predictions;
+        std::vector<double> remainingAtReplacement;
+
+        void clear()
+        {
+            nodes.clear();
+            remaining.clear();
+            capacity.clear();
+            chargeAlgorithm.clear();
+            flights.clear();
+            remainingAtReplacement.clear();
+        }
+    };
+    CandidateBatch candidateBatch;
+    /// Owner of each replacement message, backup to the context pointer of the message, see getNodeRequestingReplacement()
+    std::unordered_map<const cMessage*, NodeShadow*> replacementMsgOwners;
+
+    void link(NodeShadow* nodeShadow);
+    void unlink(NodeShadow* nodeShadow);
+    void collectAvailable();
+    static bool isIndexed(NodeStatus status)
+    {
+        return status == NodeStatus::IDLE || status == NodeStatus::CHARGING;
+    }
+    void addToIndex(NodeShadow* nodeShadow);
+    void removeFromIndex(NodeShadow* nodeShadow);
+    NodeShadow* getClosestIndexed(NodeStatus requestedStatus, double x, double y, double z);
 public:
     ManagedNodeShadows();
     virtual ~ManagedNodeShadows();
@@ -220,11 +316,35 @@ public:
     NodeShadow* getFirst(NodeStatus currentStatus);
     NodeShadow* getClosest(NodeStatus currentStatus, float x, float y, float z);
     NodeShadow* getHighestCharged();
-    NodeShadow* getHighestChargeAtReplacement(float x, float y, float z);
-    NodeShadow* getNodeRequestingReplacement(cMessage *msg); //TODO: Replace!
+    NodeShadow* getHighestChargeAtReplacement(float x, float y, float z, simtime_t timeOfReplacement);
+    void scoreCandidates(float x, float y, float z, simtime_t timeOfReplacement);
+    /**
+     * Results of the last scoreCandidates(), one entry per candidate
+     */
+    const std::vector<NodeShadow*>& getScoredCandidates() const
+    {
+        return candidateBatch.nodes;
+    }
+    /// Predicted remaining battery after the flight to the replacement location, in [mAh]
+    const std::vector<double>& getScoredRemainingAtReplacement() const
+    {
+        return candidateBatch.remainingAtReplacement;
+    }
+    /// Predicted flight duration to the replacement location, in [s]
+    const std::vector<double>& getScoredFlightDurations() const
+    {
+        return candidateBatch.predictions.duration;
+    }
+    NodeShadow* getNodeRequestingReplacement(cMessage *msg);
+    void updatePosition(NodeShadow* nodeShadow);
+    void updatePositions();
     int size() const
     {
-        return managedNodes.size();
+        return managedCount;
+    }
+    int count(NodeStatus status) const
+    {
+        return statusCounts[(int) status];
     }
 };
 
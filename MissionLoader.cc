@@ -0,0 +1,455 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <omnetpp.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MissionLoader.h"
+
+using namespace omnetpp;
+
+/// Identifies the cache format, to be changed with every change of the cache layout or of the compilation
+static const char CACHE_MAGIC[8] = { 'M', 'U', 'A', 'V', 'M', 'C', '0', '1' };
+
+struct CacheHeader {
+    char magic[8];
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    double originLatitude;
+    double originLongitude;
+    double polyAltitude;
+    uint64_t commandCount;
+};
+
+/**
+ * Read-only view of a whole file, memory mapped where available, read into memory otherwise.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& fileName)
+    {
+#ifndef _WIN32
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) throw cRuntimeError("MissionLoader: Can not open mission file '%s'", fileName.c_str());
+        struct stat status;
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            size = status.st_size;
+            void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) data = static_cast<const char *>(view);
+        }
+        close(fd);
+        if (data != nullptr || size == 0) return;
+#endif
+        std::ifstream file(fileName, std::ios::binary);
+        if (not file) throw cRuntimeError("MissionLoader: Can not open mission file '%s'", fileName.c_str());
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+        mapped = false;
+    }
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (mapped && data != nullptr) munmap(const_cast<char *>(data), size);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char *begin() const
+    {
+        return data;
+    }
+    const char *end() const
+    {
+        return data + size;
+    }
+    size_t getSize() const
+    {
+        return size;
+    }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+    bool mapped = true;
+    std::string buffer;
+};
+
+/**
+ * 64 bit FNV-1a hash of the file content
+ */
+static uint64_t hashContent(const char *begin, const char *end)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *pos = begin; pos != end; pos++) {
+        hash ^= (unsigned char) *pos;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Splits a memory range into lines and the lines into whitespace separated tokens, without copying.
+ */
+class Tokenizer {
+public:
+    Tokenizer(const char *begin, const char *end) :
+            pos(begin), end(end)
+    {
+    }
+
+    /**
+     * Advance to the next line, @return false at the end of the input
+     */
+    bool nextLine()
+    {
+        if (pos == end) return false;
+        lineBegin = pos;
+        const char *newline = static_cast<const char *>(memchr(pos, '\n', end - pos));
+        lineEnd = (newline != nullptr) ? newline : end;
+        pos = (newline != nullptr) ? newline + 1 : end;
+        if (lineEnd != lineBegin && lineEnd[-1] == '\r') lineEnd--;
+        lineNumber++;
+        return true;
+    }
+
+    /**
+     * Next token of the current line, @return false at the end of the line
+     */
+    bool nextToken(const char *&tokenBegin, const char *&tokenEnd)
+    {
+        while (lineBegin != lineEnd && isspace((unsigned char) *lineBegin)) lineBegin++;
+        if (lineBegin == lineEnd) return false;
+        tokenBegin = lineBegin;
+        while (lineBegin != lineEnd && not isspace((unsigned char) *lineBegin)) lineBegin++;
+        tokenEnd = lineBegin;
+        return true;
+    }
+
+    bool isBlankLine() const
+    {
+        for (const char *c = lineBegin; c != lineEnd; c++) {
+            if (not isspace((unsigned char) *c)) return false;
+        }
+        return true;
+    }
+
+    char firstCharacter() const
+    {
+        const char *c = lineBegin;
+        while (c != lineEnd && isspace((unsigned char) *c)) c++;
+        return (c != lineEnd) ? *c : '\0';
+    }
+
+    int getLineNumber() const
+    {
+        return lineNumber;
+    }
+
+private:
+    const char *pos;
+    const char *end;
+    const char *lineBegin = nullptr;
+    const char *lineEnd = nullptr;
+    int lineNumber = 0;
+};
+
+/**
+ * Parse the next token of the line as number, decimal commas are accepted if requested.
+ */
+static double parseNumber(Tokenizer& tokenizer, bool decimalComma, const std::string& fileName)
+{
+    const char *tokenBegin, *tokenEnd;
+    char number[64];
+    if (not tokenizer.nextToken(tokenBegin, tokenEnd) || tokenEnd - tokenBegin >= (long) sizeof(number)) {
+        throw cRuntimeError("MissionLoader: %s:%d: Number expected", fileName.c_str(), tokenizer.getLineNumber());
+    }
+    size_t length = tokenEnd - tokenBegin;
+    memcpy(number, tokenBegin, length);
+    number[length] = '\0';
+    if (decimalComma) {
+        char *comma = strchr(number, ',');
+        if (comma != nullptr) *comma = '.';
+    }
+    char *parsedEnd;
+    double value = strtod(number, &parsedEnd);
+    if (parsedEnd != number + length) {
+        throw cRuntimeError("MissionLoader: %s:%d: Malformed number '%s'", fileName.c_str(), tokenizer.getLineNumber(), number);
+    }
+    return value;
+}
+
+static bool endsWith(const std::string& text, const std::string& suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+MissionLoader::MissionLoader(double originLatitude, double originLongitude, double polyAltitude, bool useCache) :
+        originLatitude(originLatitude), originLongitude(originLongitude), polyAltitude(polyAltitude), useCache(useCache)
+{
+}
+
+// Same projection as OsgEarthScene::toX()
+double MissionLoader::toX(double longitude) const
+{
+    return (longitude - originLongitude) * cos(fabs(originLatitude / 180 * M_PI)) * 111111;
+}
+
+// Same projection as OsgEarthScene::toY()
+double MissionLoader::toY(double latitude) const
+{
+    return (originLatitude - latitude) * 111111;
+}
+
+void MissionLoader::addCommand(CompiledCommandType type, double x, double y, double z, double parameter)
+{
+    CompiledCommand command;
+    command.type = type;
+    command.reserved = 0;
+    command.x = x;
+    command.y = y;
+    command.z = z;
+    command.parameter = parameter;
+    command.legLength = commands.empty() ? 0 : sqrt(pow(x - lastX, 2) + pow(y - lastY, 2) + pow(z - lastZ, 2));
+    commands.push_back(command);
+    lastX = x;
+    lastY = y;
+    lastZ = z;
+}
+
+const std::vector<MissionLoader::CompiledCommand>& MissionLoader::compile(const std::string& fileName)
+{
+    MappedFile file(fileName);
+    uint64_t sourceHash = hashContent(file.begin(), file.end());
+    std::string cacheName = fileName + ".mcache";
+
+    commands.clear();
+    fromCache = useCache && readCache(cacheName, sourceHash, file.getSize());
+    if (fromCache) return commands;
+
+    lastX = lastY = lastZ = 0;
+    if (endsWith(fileName, ".waypoints")) {
+        parseWaypoints(file.begin(), file.end(), fileName);
+    }
+    else if (endsWith(fileName, ".track")) {
+        parseTrack(file.begin(), file.end(), fileName);
+    }
+    else if (endsWith(fileName, ".poly")) {
+        parsePoly(file.begin(), file.end(), fileName);
+    }
+    else {
+        throw cRuntimeError("MissionLoader: Unknown mission file format: '%s'", fileName.c_str());
+    }
+    if (useCache) writeCache(cacheName, sourceHash, file.getSize());
+    return commands;
+}
+
+CommandQueue MissionLoader::load(const std::string& fileName)
+{
+    compile(fileName);
+
+    CommandQueue queue;
+    double length = 0;
+    for (const CompiledCommand& command : commands) {
+        switch (command.type) {
+            case WAYPOINT:
+                queue.push_back(new WaypointCommand(command.x, command.y, command.z));
+                break;
+            case HOLD_POSITION:
+                queue.push_back(new HoldPositionCommand(command.x, command.y, command.z, (int) command.parameter));
+                break;
+            case TAKEOFF:
+                queue.push_back(new TakeoffCommand(command.z));
+                break;
+            default:
+                throw cRuntimeError("MissionLoader: Unknown command type %d in mission '%s'", command.type, fileName.c_str());
+        }
+        length += command.legLength;
+    }
+    EV_INFO << "Mission " << fileName << ": " << queue.size() << " commands, " << length << "m" << (fromCache ? " (cached)" : "") << endl;
+    return queue;
+}
+
+/**
+ * QGC WPL 110: a header line, the home position and one tab separated command per line:
+ * index, current, frame, command, param1..4, latitude, longitude, altitude, autocontinue.
+ * See: http://qgroundcontrol.org/mavlink/waypoint_protocol#waypoint_file_format
+ */
+void MissionLoader::parseWaypoints(const char *begin, const char *end, const std::string& fileName)
+{
+    Tokenizer tokenizer(begin, end);
+    // Skip header and home
+    tokenizer.nextLine();
+    tokenizer.nextLine();
+
+    double fields[12];
+    while (tokenizer.nextLine()) {
+        if (tokenizer.isBlankLine()) continue;
+        for (int i = 0; i < 12; i++) {
+            fields[i] = parseNumber(tokenizer, false, fileName);
+        }
+        int commandType = (int) fields[3];
+        double p1 = fields[4];
+        double lat = fields[8], lon = fields[9], alt = fields[10];
+
+        switch (commandType) {
+            case 16: // WAYPOINT
+                addCommand(WAYPOINT, toX(lon), toY(lat), alt);
+                break;
+            case 19: // LOITER_TIME
+                addCommand(HOLD_POSITION, toX(lon), toY(lat), alt, p1);
+                break;
+            case 22: // TAKEOFF
+                addCommand(TAKEOFF, lastX, lastY, alt);
+                break;
+            case 17: // LOITER_UNLIM
+                throw cRuntimeError("MissionLoader: %s:%d: Command not implemented yet: LOITER_UNLIM", fileName.c_str(), tokenizer.getLineNumber());
+            case 20: // RETURN_TO_LAUNCH
+                throw cRuntimeError("MissionLoader: %s:%d: Command not implemented yet: RETURN_TO_LAUNCH", fileName.c_str(), tokenizer.getLineNumber());
+            case 21: // LAND
+                throw cRuntimeError("MissionLoader: %s:%d: Command not implemented yet: LAND", fileName.c_str(), tokenizer.getLineNumber());
+            default:
+                throw cRuntimeError("MissionLoader: %s:%d: Unexpected command %d", fileName.c_str(), tokenizer.getLineNumber(), commandType);
+        }
+    }
+}
+
+void MissionLoader::parseTrack(const char *begin, const char *end, const std::string& fileName)
+{
+    Tokenizer tokenizer(begin, end);
+    const char *nameBegin, *nameEnd;
+    while (tokenizer.nextLine()) {
+        if (not tokenizer.nextToken(nameBegin, nameEnd)) continue;
+        std::string name(nameBegin, nameEnd);
+        double lat = parseNumber(tokenizer, false, fileName);
+        double lon = parseNumber(tokenizer, false, fileName);
+        double value = parseNumber(tokenizer, false, fileName);
+
+        if (name == "WAYPOINT") {
+            addCommand(WAYPOINT, toX(lon), toY(lat), value);
+        }
+        else if (name == "TAKEOFF") {
+            addCommand(TAKEOFF, lastX, lastY, value);
+        }
+        else if (name == "HOLDPOSITION") {
+            if (lat == 0 && lon == 0) {
+                addCommand(HOLD_POSITION, lastX, lastY, lastZ, value);
+            }
+            else {
+                addCommand(HOLD_POSITION, toX(lon), toY(lat), lastZ, value);
+            }
+        }
+        else {
+            throw cRuntimeError("MissionLoader: %s:%d: Unknown command '%s'", fileName.c_str(), tokenizer.getLineNumber(), name.c_str());
+        }
+    }
+}
+
+void MissionLoader::parsePoly(const char *begin, const char *end, const std::string& fileName)
+{
+    Tokenizer tokenizer(begin, end);
+    while (tokenizer.nextLine()) {
+        if (tokenizer.isBlankLine() || tokenizer.firstCharacter() == '#') continue;
+        double lat = parseNumber(tokenizer, true, fileName);
+        double lon = parseNumber(tokenizer, true, fileName);
+        addCommand(WAYPOINT, toX(lon), toY(lat), polyAltitude);
+    }
+}
+
+bool MissionLoader::readCache(const std::string& cacheName, uint64_t sourceHash, uint64_t sourceSize)
+{
+    std::ifstream cache(cacheName, std::ios::binary);
+    if (not cache) return false;
+
+    CacheHeader header;
+    if (not cache.read(reinterpret_cast<char *>(&header), sizeof(header))) return false;
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.sourceHash != sourceHash || header.sourceSize != sourceSize
+            || header.originLatitude != originLatitude || header.originLongitude != originLongitude || header.polyAltitude != polyAltitude) {
+        return false;
+    }
+
+    // a truncated or corrupt cache must not size the command buffer: the records have to fill the rest of the file exactly
+    cache.seekg(0, std::ios::end);
+    std::streamoff cacheSize = cache.tellg();
+    if (cacheSize < (std::streamoff) sizeof(header)
+            || header.commandCount != (uint64_t) (cacheSize - sizeof(header)) / sizeof(CompiledCommand)
+            || (uint64_t) (cacheSize - sizeof(header)) % sizeof(CompiledCommand) != 0) {
+        EV_WARN << "MissionLoader: Ignoring mission cache " << cacheName << " of inconsistent size" << endl;
+        return false;
+    }
+    cache.seekg(sizeof(header));
+
+    commands.resize(header.commandCount);
+    if (not cache.read(reinterpret_cast<char *>(commands.data()), header.commandCount * sizeof(CompiledCommand))) {
+        commands.clear();
+        return false;
+    }
+    for (const CompiledCommand& command : commands) {
+        if (command.type != WAYPOINT && command.type != HOLD_POSITION && command.type != TAKEOFF) {
+            EV_WARN << "MissionLoader: Ignoring mission cache " << cacheName << " with unknown command type " << command.type << endl;
+            commands.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void MissionLoader::writeCache(const std::string& cacheName, uint64_t sourceHash, uint64_t sourceSize) const
+{
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.originLatitude = originLatitude;
+    header.originLongitude = originLongitude;
+    header.polyAltitude = polyAltitude;
+    header.commandCount = commands.size();
+
+    // written to a file of this process and renamed, so concurrent runs and aborted writes never leave a partial cache
+    std::string tempName = cacheName + ".tmp";
+#ifndef _WIN32
+    tempName += std::to_string(getpid());
+#endif
+    std::ofstream cache(tempName, std::ios::binary | std::ios::trunc);
+    cache.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    cache.write(reinterpret_cast<const char *>(commands.data()), commands.size() * sizeof(CompiledCommand));
+    cache.close();
+    if (not cache) {
+        EV_WARN << "MissionLoader: Can not write mission cache " << cacheName << endl;
+        std::remove(tempName.c_str());
+        return;
+    }
+#ifdef _WIN32
+    // rename() does not replace an existing file here
+    std::remove(cacheName.c_str());
+#endif
+    if (std::rename(tempName.c_str(), cacheName.c_str()) != 0) {
+        EV_WARN << "MissionLoader: Can not replace mission cache " << cacheName << endl;
+        std::remove(tempName.c_str());
+    }
+}
@@ -0,0 +1,106 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef MISSIONLOADER_H_
+#define MISSIONLOADER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Command.h"
+
+/**
+ * Loads missions from files, projected into the local coordinates of the playground.
+ * Supported formats, chosen by file extension:
+ * <ul>
+ * <li>*.waypoints: Mission Planner / QGC WPL 110 (WAYPOINT, LOITER_TIME, TAKEOFF)</li>
+ * <li>*.track: one command per line: WAYPOINT &lt;lat&gt; &lt;lon&gt; &lt;alt&gt;, TAKEOFF &lt;lat&gt; &lt;lon&gt; &lt;alt&gt;
+ *     or HOLDPOSITION &lt;lat&gt; &lt;lon&gt; &lt;seconds&gt; (lat and lon 0: at the previous position)</li>
+ * <li>*.poly: Mission Planner polygon, one "lat lon" point per line with decimal commas, flown as waypoints at polyAltitude</li>
+ * </ul>
+ * Files are memory mapped and tokenized in place. The compiled mission is written to a binary cache next to the file
+ * (file name + ".mcache"), which is used instead of the file as long as file content and projection are unchanged.
+ */
+class MissionLoader {
+public:
+    enum CompiledCommandType : int32_t {
+        WAYPOINT = 0, HOLD_POSITION = 1, TAKEOFF = 2
+    };
+
+    /**
+     * A command of a compiled mission, the record of the binary cache.
+     * Coordinates in [m], parameter: seconds of HOLD_POSITION.
+     * legLength is the distance in [m] from the end of the previous command, 0 for the first command.
+     */
+    struct CompiledCommand {
+        int32_t type;
+        int32_t reserved;
+        double x, y, z;
+        double parameter;
+        double legLength;
+    };
+
+    /**
+     * @param originLatitude Latitude of the local coordinate origin (playground corner), see OsgEarthScene::toY()
+     * @param originLongitude Longitude of the local coordinate origin, see OsgEarthScene::toX()
+     * @param polyAltitude Altitude of the waypoints of *.poly files, in [m]
+     * @param useCache Read and write the binary cache
+     */
+    MissionLoader(double originLatitude, double originLongitude, double polyAltitude, bool useCache);
+
+    /**
+     * Compile the mission of the given file, from the cache if valid. Throws cRuntimeError on unreadable or malformed files.
+     */
+    const std::vector<CompiledCommand>& compile(const std::string& fileName);
+
+    /**
+     * Compile the mission of the given file and create its commands.
+     */
+    CommandQueue load(const std::string& fileName);
+
+    /**
+     * @return true if the last compile() used the cache
+     */
+    bool isFromCache() const
+    {
+        return fromCache;
+    }
+
+protected:
+    double originLatitude;
+    double originLongitude;
+    double polyAltitude;
+    bool useCache;
+
+    std::vector<CompiledCommand> commands;
+    bool fromCache = false;
+    /// Position at the end of the last compiled command
+    double lastX = 0, lastY = 0, lastZ = 0;
+
+    double toX(double longitude) const;
+    double toY(double latitude) const;
+    void addCommand(CompiledCommandType type, double x, double y, double z, double parameter = 0);
+
+    void parseWaypoints(const char *begin, const char *end, const std::string& fileName);
+    void parseTrack(const char *begin, const char *end, const std::string& fileName);
+    void parsePoly(const char *begin, const char *end, const std::string& fileName);
+
+    bool readCache(const std::string& cacheName, uint64_t sourceHash, uint64_t sourceSize);
+    void writeCache(const std::string& cacheName, uint64_t sourceHash, uint64_t sourceSize) const;
+};
+
+#endif /* MISSIONLOADER_H_ */
@@ -0,0 +1,45 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include "MissionProgram.h"
+
+MissionProgram::MissionProgram(const CommandQueue& commands) :
+        commands(commands.begin(), commands.end())
+{
+    takeoff.reserve(commands.size());
+    for (Command *command : commands) {
+        takeoff.push_back(dynamic_cast<TakeoffCommand *>(command) != nullptr);
+    }
+}
+
+MissionProgram::~MissionProgram()
+{
+    for (Command *command : commands) {
+        delete command;
+    }
+}
+
+void MissionProgram::getSequence(size_t programCounter, bool repeat, bool wrapped, std::vector<size_t>& indices) const
+{
+    indices.clear();
+    size_t count = commands.size();
+    for (size_t k = programCounter; k < programCounter + count; k++) {
+        bool secondPass = (k >= count);
+        if (secondPass && not repeat) break;
+        size_t index = k % count;
+        if (takeoff[index] && (secondPass || wrapped)) continue;
+        indices.push_back(index);
+    }
+}
@@ -0,0 +1,75 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef MISSIONPROGRAM_H_
+#define MISSIONPROGRAM_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "Command.h"
+
+/**
+ * A mission compiled once and shared read-only by all nodes flying it, see MissionProgramHandle.
+ * Nodes refer to their position in the program by a program counter, the index of the next mission command,
+ * and instantiate their CEEs for a program only once.
+ * The program owns its commands.
+ */
+class MissionProgram {
+public:
+    MissionProgram(const CommandQueue& commands);
+    virtual ~MissionProgram();
+    MissionProgram(const MissionProgram&) = delete;
+    MissionProgram& operator=(const MissionProgram&) = delete;
+
+    size_t size() const
+    {
+        return commands.size();
+    }
+    bool empty() const
+    {
+        return commands.empty();
+    }
+    Command* at(size_t index) const
+    {
+        return commands.at(index);
+    }
+    bool isTakeoff(size_t index) const
+    {
+        return takeoff.at(index);
+    }
+
+    /**
+     * Indices of the commands still to execute from the given program counter on, in execution order.
+     * A repeating program continues at its start after the last command. TAKEOFF commands are executed in the first pass only:
+     * skipped before the program counter (flown already or by the node started at the program counter) and, once the program
+     * wrapped around, everywhere.
+     *
+     * @param programCounter Index of the next command, size() if none is left
+     */
+    void getSequence(size_t programCounter, bool repeat, bool wrapped, std::vector<size_t>& indices) const;
+
+protected:
+    std::vector<Command *> commands;
+    std::vector<bool> takeoff;
+};
+
+/**
+ * Reference-counted handle of an immutable mission program, passed between MissionControl and the nodes instead of command copies.
+ */
+typedef std::shared_ptr<const MissionProgram> MissionProgramHandle;
+
+#endif /* MISSIONPROGRAM_H_ */
@@ -24,6 +24,7 @@
 #include <osgEarthFeatures/Feature>
 
 #include "MobileNode.h"
+#include "ChargingNodeRegistry.h"
 #include "OsgEarthScene.h"
 
 using namespace omnetpp;
@@ -237,29 +238,12 @@ osg::Vec4f MobileNode::hsv2rgb(double h, double s, double v)
     return colorVec;
 }
 
+/**
+ * Nearest charging node by the sum of the absolute coordinate differences, see ChargingNodeRegistry.
+ */
 ChargingNode* MobileNode::findNearestCN(double nodeX, double nodeY, double nodeZ)
 {
-    //cModule* osgEarthNet = getModuleByPath("OsgEarthNet");
-    //cModule* osgEarthNet = getModuleByPath("OsgEarthNet.cs");
-    //EV_INFO << "MobileNode #" << this->getIndex() << " name: " << this->getFullName() << " parent name: " << osgEarthNet->getFullName() << endl;
-    double minDistance = DBL_MAX;
-    ChargingNode *nearest = nullptr;
-    cModule *network = cSimulation::getActiveSimulation()->getSystemModule();
-    for (SubmoduleIterator it(network); !it.end(); ++it) {
-        cModule *mod = *it;
-        if (mod->isName("cs")) {
-            //EV << "Module " << mod->getName() << mod->getFullName() << mod->getFullPath() << endl;
-            ChargingNode *cs = dynamic_cast<ChargingNode *>(mod);
-            double distanceSum = fabs(cs->getX() - nodeX) + fabs(cs->getY() - nodeY) + fabs(cs->getZ() - nodeZ);
-            //EV << "ChargingNode " << cs->getFullName() << " distanceSum=" << distanceSum << endl;
-            if (distanceSum < minDistance) {
-                minDistance = distanceSum;
-                nearest = cs;
-            }
-        }
-    }
-    //EV << "ChargingNode selected: " << nearest->getFullName() << endl;
-    return nearest;
+    return ChargingNodeRegistry::getInstance().findNearest(nodeX, nodeY, nodeZ);
 }
 
 Battery* MobileNode::getBattery()
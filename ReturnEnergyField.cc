@@ -0,0 +1,137 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <omnetpp.h>
+
+#include "ReturnEnergyField.h"
+#include "ChargingNodeRegistry.h"
+
+using namespace omnetpp;
+
+constexpr size_t ReturnEnergyField::MAX_GRID_POINTS;
+
+void ReturnEnergyField::predictReturnFlights(const EnergyModel& energyModel, double quantileZ, const std::vector<double>& x,
+        const std::vector<double>& y, const std::vector<double>& z, std::vector<ReturnFlight>& result)
+{
+    ChargingNodeRegistry& registry = ChargingNodeRegistry::getInstance();
+    LegBatch batch;
+    batch.reserve(x.size());
+    result.resize(x.size());
+    for (size_t idx = 0; idx < x.size(); idx++) {
+        double cnX, cnY, cnZ;
+        if (not registry.findNearest(x[idx], y[idx], z[idx], result[idx].cn, cnX, cnY, cnZ)) {
+            throw cRuntimeError("No charging station available!");
+        }
+        batch.addMovement(cnX - x[idx], cnY - y[idx], cnZ - z[idx]);
+    }
+
+    LegPredictions predictions;
+    energyModel.predictLegs(batch, quantileZ, predictions);
+    for (size_t idx = 0; idx < x.size(); idx++) {
+        result[idx].energy = predictions.energyQuantile[idx];
+        result[idx].duration = predictions.duration[idx];
+    }
+}
+
+void ReturnEnergyField::predictPoints(const EnergyModel& energyModel, double quantileZ, const std::vector<double>& x,
+        const std::vector<double>& y, const std::vector<double>& z)
+{
+    clear();
+    predictReturnFlights(energyModel, quantileZ, x, y, z, points);
+    if (x.empty()) return;
+
+    minX = *std::min_element(x.begin(), x.end());
+    minY = *std::min_element(y.begin(), y.end());
+    minZ = *std::min_element(z.begin(), z.end());
+    maxX = *std::max_element(x.begin(), x.end());
+    maxY = *std::max_element(y.begin(), y.end());
+    maxZ = *std::max_element(z.begin(), z.end());
+}
+
+void ReturnEnergyField::buildGrid(const EnergyModel& energyModel, double quantileZ, double cellSize)
+{
+    gridEnergy.clear();
+    gridDuration.clear();
+    this->cellSize = cellSize;
+    if (cellSize <= 0 || points.empty()) return;
+
+    gridX = minX - cellSize;
+    gridY = minY - cellSize;
+    gridZ = minZ - cellSize;
+    nodesX = (long) ceil((maxX - minX) / cellSize) + 3;
+    nodesY = (long) ceil((maxY - minY) / cellSize) + 3;
+    nodesZ = (long) ceil((maxZ - minZ) / cellSize) + 3;
+    if ((double) nodesX * nodesY * nodesZ > MAX_GRID_POINTS) {
+        throw cRuntimeError("ReturnEnergyField: %ld x %ld x %ld grid points for cell size %g exceed the limit of %lu", nodesX, nodesY, nodesZ,
+                cellSize, (unsigned long) MAX_GRID_POINTS);
+    }
+
+    std::vector<double> x, y, z;
+    size_t count = nodesX * nodesY * nodesZ;
+    x.reserve(count);
+    y.reserve(count);
+    z.reserve(count);
+    for (long k = 0; k < nodesZ; k++) {
+        for (long j = 0; j < nodesY; j++) {
+            for (long i = 0; i < nodesX; i++) {
+                x.push_back(gridX + i * cellSize);
+                y.push_back(gridY + j * cellSize);
+                z.push_back(gridZ + k * cellSize);
+            }
+        }
+    }
+
+    std::vector<ReturnFlight> flights;
+    predictReturnFlights(energyModel, quantileZ, x, y, z, flights);
+    gridEnergy.resize(count);
+    gridDuration.resize(count);
+    for (size_t idx = 0; idx < count; idx++) {
+        gridEnergy[idx] = flights[idx].energy;
+        gridDuration[idx] = flights[idx].duration;
+    }
+}
+
+bool ReturnEnergyField::interpolate(double x, double y, double z, double& energy, double& duration) const
+{
+    if (not hasGrid()) return false;
+
+    double fx = (x - gridX) / cellSize, fy = (y - gridY) / cellSize, fz = (z - gridZ) / cellSize;
+    if (fx < 0 || fy < 0 || fz < 0 || fx > nodesX - 1 || fy > nodesY - 1 || fz > nodesZ - 1) return false;
+
+    long i = std::min((long) fx, nodesX - 2), j = std::min((long) fy, nodesY - 2), k = std::min((long) fz, nodesZ - 2);
+    double wx = fx - i, wy = fy - j, wz = fz - k;
+    size_t base = (k * nodesY + j) * nodesX + i;
+    size_t stepY = nodesX, stepZ = nodesX * nodesY;
+
+    auto trilinear = [&](const std::vector<double>& values) {
+        double c00 = values[base] * (1 - wx) + values[base + 1] * wx;
+        double c10 = values[base + stepY] * (1 - wx) + values[base + stepY + 1] * wx;
+        double c01 = values[base + stepZ] * (1 - wx) + values[base + stepZ + 1] * wx;
+        double c11 = values[base + stepZ + stepY] * (1 - wx) + values[base + stepZ + stepY + 1] * wx;
+        return (c00 * (1 - wy) + c10 * wy) * (1 - wz) + (c01 * (1 - wy) + c11 * wy) * wz;
+    };
+    energy = trilinear(gridEnergy);
+    duration = trilinear(gridDuration);
+    return true;
+}
+
+void ReturnEnergyField::clear()
+{
+    points.clear();
+    gridEnergy.clear();
+    gridDuration.clear();
+}
@@ -0,0 +1,100 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef RETURNENERGYFIELD_H_
+#define RETURNENERGYFIELD_H_
+
+#include <vector>
+#include <cstddef>
+
+#include "EnergyModel.h"
+
+class ChargingNode;
+
+/**
+ * Predicted return flights to the nearest charging node (see ChargingNodeRegistry::findNearest()), precomputed for a mission.
+ * Holds the exact predictions for a fixed set of points, e.g. the command endpoints,
+ * and optionally a coarse grid over their surroundings that is trilinearly interpolated for arbitrary points.
+ * Energies are the prediction quantile in [mAh], durations in [s].
+ */
+class ReturnEnergyField {
+public:
+    struct ReturnFlight {
+        ChargingNode *cn;
+        double energy;
+        double duration;
+    };
+
+    /// Upper bound of grid points, a finer grid is rejected
+    static constexpr size_t MAX_GRID_POINTS = 1 << 20;
+
+    /**
+     * Predict the return flights from all given points in one batch, replaces all previous data.
+     * Throws if no charging node is registered.
+     */
+    void predictPoints(const EnergyModel& energyModel, double quantileZ, const std::vector<double>& x, const std::vector<double>& y,
+            const std::vector<double>& z);
+
+    /**
+     * Return flight from point idx of the last predictPoints() call.
+     */
+    const ReturnFlight& getPoint(size_t idx) const
+    {
+        return points[idx];
+    }
+    size_t getPointCount() const
+    {
+        return points.size();
+    }
+
+    /**
+     * Build the grid over the bounding box of the points of predictPoints(), extended by one cell on each side.
+     *
+     * @param cellSize Edge length of the cubic cells, in [m]. 0 removes the grid.
+     */
+    void buildGrid(const EnergyModel& energyModel, double quantileZ, double cellSize);
+    bool hasGrid() const
+    {
+        return not gridEnergy.empty();
+    }
+
+    /**
+     * Approximate return flight from an arbitrary point, interpolated between the corners of its grid cell.
+     *
+     * @return false if there is no grid or the point is outside of it
+     */
+    bool interpolate(double x, double y, double z, double& energy, double& duration) const;
+
+    void clear();
+
+protected:
+    std::vector<ReturnFlight> points;
+    double minX = 0, minY = 0, minZ = 0, maxX = 0, maxY = 0, maxZ = 0;
+
+    double cellSize = 0;
+    double gridX = 0, gridY = 0, gridZ = 0;
+    long nodesX = 0, nodesY = 0, nodesZ = 0;
+    /// per grid point, x fastest
+    std::vector<double> gridEnergy;
+    std::vector<double> gridDuration;
+
+    /**
+     * Predict the return flights from the given points into energy and duration.
+     */
+    static void predictReturnFlights(const EnergyModel& energyModel, double quantileZ, const std::vector<double>& x, const std::vector<double>& y,
+            const std::vector<double>& z, std::vector<ReturnFlight>& result);
+};
+
+#endif /* RETURNENERGYFIELD_H_ */
@@ -0,0 +1,72 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <boost/math/distributions/normal.hpp>
+
+#include "TruncatedNormalSampler.h"
+
+using namespace omnetpp;
+
+constexpr double TruncatedNormalSampler::MAX_SIGMA;
+constexpr int TruncatedNormalSampler::TABLE_SIZE;
+
+TruncatedNormalSampler::TruncatedNormalSampler()
+{
+    boost::math::normal standardNormal(0, 1);
+    lowestProbability = cdf(-MAX_SIGMA);
+    probabilityStep = (cdf(MAX_SIGMA) - lowestProbability) / TABLE_SIZE;
+
+    inverseCdf.resize(TABLE_SIZE + 1);
+    inverseCdf[0] = -MAX_SIGMA;
+    inverseCdf[TABLE_SIZE] = MAX_SIGMA;
+    for (int i = 1; i < TABLE_SIZE; i++) {
+        inverseCdf[i] = boost::math::quantile(standardNormal, lowestProbability + i * probabilityStep);
+    }
+}
+
+const TruncatedNormalSampler& TruncatedNormalSampler::getInstance()
+{
+    static const TruncatedNormalSampler sampler;
+    return sampler;
+}
+
+double TruncatedNormalSampler::cdf(double x)
+{
+    return 0.5 * erfc(-x / M_SQRT2);
+}
+
+double TruncatedNormalSampler::drawStandard(cRNG *rng, double lower, double upper) const
+{
+    lower = std::min(std::max(lower, -MAX_SIGMA), MAX_SIGMA);
+    upper = std::min(std::max(upper, -MAX_SIGMA), MAX_SIGMA);
+    if (upper <= lower) return lower;
+
+    // map the uniform number onto the probability range of [lower, upper], then into the table
+    double lowerProbability = cdf(lower);
+    double probability = lowerProbability + rng->doubleRand() * (cdf(upper) - lowerProbability);
+    double position = (probability - lowestProbability) / probabilityStep;
+    int idx = std::min(std::max((int) position, 0), TABLE_SIZE - 1);
+    double value = inverseCdf[idx] + (inverseCdf[idx + 1] - inverseCdf[idx]) * (position - idx);
+    // interpolation and rounding must not leave the interval
+    return std::min(std::max(value, lower), upper);
+}
+
+double TruncatedNormalSampler::draw(cRNG *rng, double mean, double stddev, double lower, double upper) const
+{
+    if (stddev <= 0) return mean;
+    return mean + drawStandard(rng, lower, upper) * stddev;
+}
@@ -0,0 +1,61 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef TRUNCATEDNORMALSAMPLER_H_
+#define TRUNCATEDNORMALSAMPLER_H_
+
+#include <vector>
+#include <omnetpp.h>
+
+/**
+ * Draws from a normal distribution truncated to an interval within +-MAX_SIGMA standard deviations.
+ * Uses the inverse CDF on a precomputed table: every draw consumes exactly one uniform number of the given RNG,
+ * independent of the bounds (unlike a rejection loop).
+ */
+class TruncatedNormalSampler {
+public:
+    /// Widest supported truncation, in standard deviations
+    static constexpr double MAX_SIGMA = 3;
+    /// Number of intervals of the inverse CDF table
+    static constexpr int TABLE_SIZE = 8192;
+
+    /**
+     * Shared sampler, the table is built on first use.
+     */
+    static const TruncatedNormalSampler& getInstance();
+
+    /**
+     * Draw from the standard normal distribution truncated to [lower, upper].
+     * Bounds are clipped to +-MAX_SIGMA, an empty interval returns the (clipped) lower bound.
+     */
+    double drawStandard(omnetpp::cRNG *rng, double lower, double upper) const;
+
+    /**
+     * Draw from N(mean, stddev^2) truncated to [mean + lower * stddev, mean + upper * stddev].
+     */
+    double draw(omnetpp::cRNG *rng, double mean, double stddev, double lower, double upper) const;
+
+protected:
+    TruncatedNormalSampler();
+
+    /// Standard normal quantiles for TABLE_SIZE + 1 equidistant probabilities from cdf(-MAX_SIGMA) to cdf(MAX_SIGMA)
+    std::vector<double> inverseCdf;
+    double lowestProbability;
+    double probabilityStep;
+
+    static double cdf(double x);
+};
+
+#endif /* TRUNCATEDNORMALSAMPLER_H_ */
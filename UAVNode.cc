@@ -14,6 +14,7 @@
 //
 
 #ifdef WITH_OSG
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -21,6 +22,7 @@
 #include "UAVNode.h"
 #include "OsgEarthScene.h"
 #include "ChannelController.h"
+#include "ChargingNodeRegistry.h"
 
 #include "msgs/MissionMsg_m.h"
 #include "msgs/ExchangeCompletedMsg_m.h"
@@ -37,6 +39,8 @@ UAVNode::UAVNode()
 
 UAVNode::~UAVNode()
 {
+    for (auto vector : shadowCommandsVectors) delete vector;
+    for (auto vector : shadowDurationVectors) delete vector;
 }
 
 /**
@@ -54,6 +58,33 @@ void UAVNode::initialize(int stage)
             y = par("startY");
             z = par("startZ");
             quantile = par("predictionQuantile").doubleValue();
+            if (quantile <= 0 || quantile >= 1) throw cRuntimeError("predictionQuantile must be within (0, 1), got %f", quantile);
+            // The quantile is fixed for the whole run, derive its standard normal z-score only once
+            quantileZ = boost::math::quantile(boost::math::normal(0, 1), quantile);
+            if (par("legCacheSize").intValue() < 0) throw cRuntimeError("legCacheSize must not be negative");
+            if (par("legCacheResolution").doubleValue() <= 0) throw cRuntimeError("legCacheResolution must be positive");
+            legCache.configure(par("legCacheSize").intValue(), par("legCacheResolution").doubleValue());
+            energyModel = EnergyModel::getShared(par("energyModelFile").stdstringValue(), par("energyModelAngleResolution").doubleValue());
+            returnFieldCellSize = par("returnFieldCellSize").doubleValue();
+            if (returnFieldCellSize < 0) throw cRuntimeError("returnFieldCellSize must not be negative");
+            replacementLeadTime = par("replacementLeadTime");
+            if (replacementLeadTime < 0) throw cRuntimeError("replacementLeadTime must not be negative");
+            WATCH(replacementRecomputations);
+            WATCH(replacementRecomputationsSkipped);
+            WATCH(commandArena);
+            if (par("shadowDecisions").boolValue()) {
+                for (double weight : cStringTokenizer(par("shadowWeights").stringValue()).asDoubleVector()) {
+                    if (weight < 0 || weight > 1) throw cRuntimeError("shadowWeights must be within [0, 1], got %f", weight);
+                    shadowWeights.push_back(weight);
+                }
+                addShadowDecision("latestOpportunity");
+                addShadowDecision("shortestReturn");
+                for (float weight : shadowWeights) {
+                    std::ostringstream name;
+                    name << "biObjective(w=" << weight << ")";
+                    addShadowDecision(name.str());
+                }
+            }
             break;
         }
         case 1: {
@@ -83,6 +114,15 @@ void UAVNode::finish()
 
     if (utilizationFail && missionId >= 0) throw cRuntimeError("Nope!");
 
+    recordScalar("legCacheHits", legCache.getHits());
+    recordScalar("legCacheMisses", legCache.getMisses());
+    recordScalar("replacementRecomputations", replacementRecomputations);
+    recordScalar("replacementRecomputationsSkipped", replacementRecomputationsSkipped);
+    recordScalar("commandArenaLiveCommands", commandArena.getLiveCommands());
+    recordScalar("commandArenaLiveCEEs", commandArena.getLiveCEEs());
+    recordScalar("commandArenaPeakObjects", commandArena.getPeakObjects());
+    recordScalar("commandArenaFreedObjects", commandArena.getFreedObjects());
+
     MobileNode::finish();
 }
 
@@ -93,10 +133,12 @@ void UAVNode::handleMessage(cMessage *msg)
     if (msg->isName("initIdle")) {
         missionId = -2;
         cees.clear();
-        CommandExecEngine *cee = new IdleCEE(this, new IdleCommand());
+        ceesGeneration++;
+        CommandExecEngine *cee = commandArena.create<IdleCEE>(this, commandArena.create<IdleCommand>());
         cee->setCommandId(-2);
         cee->setPartOfMission(false);
         cees.push_back(cee);
+        commandArena.collect(cees, commandExecEngine);
         //collectStatistics(); // No CEE active before this step
         selectNextCommand();
         initializeState();
@@ -115,7 +157,9 @@ void UAVNode::handleMessage(cMessage *msg)
             receivedMission_valid = true;
             receivedMission_missionId = receivedMissionMsg->getMissionId();
             receivedMission_commandsRepeat = receivedMissionMsg->getMissionRepeat();
-            receivedMission_missionCommands = receivedMissionMsg->getMission();
+            receivedMission_program = receivedMissionMsg->getProgram();
+            receivedMission_programCounter = receivedMissionMsg->getProgramCounter();
+            receivedMission_programWrapped = receivedMissionMsg->getProgramWrapped();
             delete msg;
             msg = nullptr;
             return;
@@ -126,10 +170,7 @@ void UAVNode::handleMessage(cMessage *msg)
         MissionMsg * receivedMissionMsg = check_and_cast<MissionMsg *>(msg);
         missionId = receivedMissionMsg->getMissionId();
         commandsRepeat = receivedMissionMsg->getMissionRepeat();
-        CommandQueue missionCommands = receivedMissionMsg->getMission();
-        EV_INFO << __func__ << "(): Mission " << missionId << " exchange, clearing " << cees.size() << " cees, loading " << missionCommands.size() << endl;
-        clearCommands();
-        loadCommands(missionCommands);
+        loadMission(receivedMissionMsg->getProgram(), receivedMissionMsg->getProgramCounter(), receivedMissionMsg->getProgramWrapped());
 
         // End ExchangeCEE, will trigger next command selection
         exchangeCEE->setCommandCompleted();
@@ -178,16 +219,43 @@ void UAVNode::handleMessage(cMessage *msg)
     }
 }
 
+/**
+ * Hand the mission over to the replacing node: the program handle and the program counter.
+ * A mission loaded as commands becomes a program of its remaining mission commands, which leave the arena of this node.
+ */
 void UAVNode::transferMissionDataTo(UAVNode* node)
 {
-    CommandQueue missionCommands = *extractCommands();
+    size_t programCounter = 0;
+    if (program) {
+        programCounter = getProgramCounter();
+    }
+    else {
+        CommandQueue *missionCommands = extractCommands();
+        commandArena.release(*missionCommands);
+        program = std::make_shared<const MissionProgram>(*missionCommands);
+        programWrapped = false;
+        delete missionCommands;
+    }
     MissionMsg *exDataMsg = new MissionMsg("exchangeData");
-    exDataMsg->setMission(missionCommands);
+    exDataMsg->setProgram(program);
+    exDataMsg->setProgramCounter(programCounter);
+    exDataMsg->setProgramWrapped(programWrapped);
+    EV_INFO << __func__ << "(): Program at command " << programCounter << " sent to other node." << endl;
     exDataMsg->setMissionRepeat(commandsRepeat);
     exDataMsg->setMissionId(missionId);
     cGate* gateToNode = getOutputGateTo(node);
     send(exDataMsg, gateToNode);
-    EV_INFO << __func__ << "(): " << missionCommands.size() << " commands extracted and sent to other node." << endl;
+}
+
+/**
+ * Index of the next mission command of the program in cees, the size of the program if none is left.
+ */
+size_t UAVNode::getProgramCounter() const
+{
+    for (CommandExecEngine *cee : cees) {
+        if (cee->isPartOfMission()) return cee->getCommandId();
+    }
+    return program->size();
 }
 
 /**
@@ -204,7 +272,7 @@ void UAVNode::selectNextCommand()
 
     CommandExecEngine *scheduledCEE = cees.front();
     scheduledCEE->setFromCoordinates(getX(), getY(), getZ());
-    scheduledCEE->initializeCEE();
+    scheduledCEE->prepareCEE();
 
     if (exchangeAfterCurrentCommand && not scheduledCEE->isCeeType(CeeType::EXCHANGE)) {
         std::string error_msg = "selectNextCommand(): " + std::string(this->getFullName())
@@ -216,9 +284,10 @@ void UAVNode::selectNextCommand()
         exchangeAfterCurrentCommand = false;
     }
 
+    // safety decisions on exact predictions only, the interpolated return field is for planning
     float energyForSheduled = scheduledCEE->predictFullConsumptionQuantile();
-    float energyToCNNow = energyToNearestCN(getX(), getY(), getZ());
-    float energyToCNAfterScheduled = energyToNearestCN(scheduledCEE->getX1(), scheduledCEE->getY1(), scheduledCEE->getZ1());
+    float energyToCNNow = predictEnergyToNearestCN(getX(), getY(), getZ());
+    float energyToCNAfterScheduled = energyToCNAfter(scheduledCEE);
     float energyRemaining = this->battery.getRemaining();
     bool atReplacementLocation = (abs(replacementX - x) + abs(replacementY - y) + abs(replacementZ - z)) < ERROR_MARGIN
             && abs((replacementTime - simTime()).dbl()) < 10 * ERROR_MARGIN;
@@ -262,15 +331,16 @@ void UAVNode::selectNextCommand()
 
         // Generate and inject ExchangeCEE, only if not already done
         if (scheduledCEE->isPartOfMission()) {
-            ExchangeCommand *exchangeCommand = new ExchangeCommand(replacingNode, true, true);
+            ExchangeCommand *exchangeCommand = commandArena.create<ExchangeCommand>(replacingNode, true, true);
             exchangeCommand->setX(replacementX);
             exchangeCommand->setY(replacementY);
             exchangeCommand->setZ(replacementZ);
-            CommandExecEngine *exchangeCEE = new ExchangeCEE(this, exchangeCommand);
+            CommandExecEngine *exchangeCEE = commandArena.create<ExchangeCEE>(this, exchangeCommand);
             exchangeCEE->setFromCoordinates(replacementX, replacementY, replacementZ);
             exchangeCEE->setToCoordinates(replacementX, replacementY, replacementZ);
             exchangeCEE->setPartOfMission(false);
             cees.push_front(exchangeCEE);
+            ceesGeneration++;
             EV_INFO << __func__ << "(): ExchangeCEE added to node." << endl;
         }
     }
@@ -278,7 +348,7 @@ void UAVNode::selectNextCommand()
     // Activate next CEE
     commandExecEngine = cees.front();
     commandExecEngine->setFromCoordinates(getX(), getY(), getZ());
-    commandExecEngine->initializeCEE();
+    commandExecEngine->prepareCEE();
     cees.pop_front();
 
     // Unset mission ID after mission
@@ -289,6 +359,9 @@ void UAVNode::selectNextCommand()
     if (commandsRepeat && (commandExecEngine->isPartOfMission()) && not (commandExecEngine->isCeeType(CeeType::TAKEOFF))) {
         cees.push_back(commandExecEngine);
     }
+    if (program && commandExecEngine->isPartOfMission() && commandExecEngine->getCommandId() + 1 == (int) program->size()) {
+        programWrapped = true;
+    }
     EV_INFO << "New command loaded is " << commandExecEngine->getCeeTypeString() << " (MissionID " << missionId << ", commandID "
             << commandExecEngine->getCommandId() << " to (" << commandExecEngine->getX1() << ", " << commandExecEngine->getY1() << ", "
             << commandExecEngine->getZ1() << "))" << endl;
@@ -368,7 +441,7 @@ void UAVNode::initializeState()
 {
     if (commandExecEngine == nullptr) throw cRuntimeError("initializeState(): Command Engine missing.");
 
-    commandExecEngine->initializeCEE();
+    commandExecEngine->armCEE();
     commandExecEngine->performEntryActions();
     commandExecEngine->setNodeParameters();
 
@@ -416,10 +489,8 @@ void UAVNode::updateState()
 
         missionId = receivedMission_missionId;
         commandsRepeat = receivedMission_commandsRepeat;
-        CommandQueue missionCommands = receivedMission_missionCommands;
-        EV_INFO << __func__ << "(): Mission " << missionId << " exchange, clearing " << cees.size() << " cees, loading " << missionCommands.size() << endl;
-        clearCommands();
-        loadCommands(missionCommands);
+        loadMission(receivedMission_program, receivedMission_programCounter, receivedMission_programWrapped);
+        receivedMission_program.reset();
 
         // End ExchangeCEE, will trigger next command selection
         exchangeCEE->setCommandCompleted();
@@ -477,6 +548,21 @@ double UAVNode::nextNeededUpdate()
     }
 }
 
+void UAVNode::clearCommands()
+{
+    program.reset();
+    programWrapped = false;
+    dropProgramCEEs();
+    GenericNode::clearCommands();
+    missionCycle.cees.clear();
+    ceesGeneration++;
+    returnField.clear();
+    returnFlightIndex.clear();
+    activeReturnField = &returnField;
+    activeReturnFlightIndex = &returnFlightIndex;
+    activeReturnFieldVersion = ChargingNodeRegistry::getInstance().getVersion();
+}
+
 /**
  * Load a queue of commands, generate cees out of these and store them as the cees to be executed by the node.
  */
@@ -486,44 +572,232 @@ void UAVNode::loadCommands(CommandQueue commands, bool isMission)
         EV_WARN << __func__ << "()" << " Replacing non-empty CEE queue." << endl;
         cees.clear();
     }
+    missionCycle.cees.clear();
+    ceesGeneration++;
+    program.reset();
+    programWrapped = false;
 
     for (u_int index = 0; index < commands.size(); ++index) {
         Command *command = commands.at(index);
-        CommandExecEngine *cee = nullptr;
-
-        if (WaypointCommand *cmd = dynamic_cast<WaypointCommand *>(command)) {
-            cee = new WaypointCEE(this, cmd);
-        }
-        else if (TakeoffCommand *cmd = dynamic_cast<TakeoffCommand *>(command)) {
-            cee = new TakeoffCEE(this, cmd);
-        }
-        else if (HoldPositionCommand *cmd = dynamic_cast<HoldPositionCommand *>(command)) {
-            // only if HoldPositionCommand is first command of mission and UAVNode is not already there
-            if (isMission && index == 0 && not cmpCoord(*cmd, getX(), getY(), getZ())) {
-                WaypointCommand* extraCommand = new WaypointCommand(cmd->getX(), cmd->getY(), cmd->getZ());
-                CommandExecEngine* extraCee = new WaypointCEE(this, extraCommand);
-                extraCee->setPartOfMission(false);
-                cees.push_back(extraCee);
-            }
-            cee = new HoldPositionCEE(this, cmd);
-        }
-        else if (ChargeCommand *cmd = dynamic_cast<ChargeCommand *>(command)) {
-            cee = new ChargeCEE(this, cmd);
-        }
-        else if (ExchangeCommand *cmd = dynamic_cast<ExchangeCommand *>(command)) {
-            cee = new ExchangeCEE(this, cmd);
-        }
-        else if (IdleCommand *cmd = dynamic_cast<IdleCommand *>(command)) {
-            cee = new IdleCEE(this, cmd);
-        }
-        else {
-            throw cRuntimeError("UAVNode::loadCommands(): invalid cast or unexpected command type.");
+        // only if HoldPositionCommand is first command of mission and UAVNode is not already there
+        HoldPositionCommand *holdCommand = dynamic_cast<HoldPositionCommand *>(command);
+        if (holdCommand && isMission && index == 0 && not cmpCoord(*holdCommand, getX(), getY(), getZ())) {
+            WaypointCommand* extraCommand = commandArena.create<WaypointCommand>(holdCommand->getX(), holdCommand->getY(), holdCommand->getZ());
+            CommandExecEngine* extraCee = commandArena.create<WaypointCEE>(this, extraCommand);
+            extraCee->setPartOfMission(false);
+            cees.push_back(extraCee);
         }
+        CommandExecEngine *cee = commandArena.adopt(createCEE(command));
         if (not isMission) cee->setPartOfMission(false);
         cee->setCommandId(index);
         cees.push_back(cee);
     }
+    commandArena.collect(cees, commandExecEngine);
     EV_INFO << __func__ << "(): " << commands.size() << " commands stored in node memory." << endl;
+    predictReturnFlights();
+}
+
+/**
+ * Load a mission program from the program counter on (see MissionProgram::getSequence()) as the cees to be executed by the node.
+ * The CEEs of the program are created on its first load only, their command IDs are the program indices.
+ */
+void UAVNode::loadProgram(const MissionProgramHandle& program, size_t programCounter, bool programWrapped)
+{
+    if (not cees.empty()) {
+        EV_WARN << __func__ << "()" << " Replacing non-empty CEE queue." << endl;
+        cees.clear();
+    }
+    missionCycle.cees.clear();
+    ceesGeneration++;
+    this->program = program;
+    this->programWrapped = programWrapped;
+    dropProgramCEEs();
+
+    ProgramCEEs& instance = getProgramCEEs(program);
+    program->getSequence(programCounter, commandsRepeat, programWrapped, programSequence);
+    for (size_t index : programSequence) {
+        // only if HoldPositionCommand is first command loaded and UAVNode is not already there
+        HoldPositionCommand *holdCommand = dynamic_cast<HoldPositionCommand *>(program->at(index));
+        if (holdCommand && cees.empty() && not cmpCoord(*holdCommand, getX(), getY(), getZ())) {
+            if (instance.approachCEEs[index] == nullptr) {
+                WaypointCommand* extraCommand = commandArena.createRetained<WaypointCommand>(holdCommand->getX(), holdCommand->getY(),
+                        holdCommand->getZ());
+                instance.approachCEEs[index] = commandArena.createRetained<WaypointCEE>(this, extraCommand);
+                instance.approachCEEs[index]->setPartOfMission(false);
+            }
+            cees.push_back(instance.approachCEEs[index]);
+        }
+        cees.push_back(instance.cees[index]);
+    }
+    commandArena.collect(cees, commandExecEngine);
+    EV_INFO << __func__ << "(): " << programSequence.size() << " commands of the program loaded from command " << programCounter << "." << endl;
+    predictProgramReturnFlights(instance);
+}
+
+/**
+ * Replace the commands by the mission received in an exchange.
+ */
+void UAVNode::loadMission(const MissionProgramHandle& program, size_t programCounter, bool programWrapped)
+{
+    EV_INFO << __func__ << "(): Mission " << missionId << " exchange, clearing " << cees.size() << " cees" << endl;
+    clearCommands();
+    loadProgram(program, programCounter, programWrapped);
+}
+
+/**
+ * The CEEs of the given program of this node, created on first use.
+ */
+UAVNode::ProgramCEEs& UAVNode::getProgramCEEs(const MissionProgramHandle& program)
+{
+    ProgramCEEs& instance = programCEEs[program.get()];
+    if (instance.program == nullptr) {
+        instance.program = program;
+        instance.approachCEEs.assign(program->size(), nullptr);
+        for (size_t index = 0; index < program->size(); index++) {
+            CommandExecEngine *cee = commandArena.adopt(createCEE(program->at(index)), true);
+            cee->setCommandId(index);
+            instance.cees.push_back(cee);
+        }
+    }
+    return instance;
+}
+
+/**
+ * Drop the CEEs of every program only kept alive by this node's own ProgramCEEs, e.g. a program made of commands on a hand-over
+ * (see transferMissionDataTo()), unless the active CEE is one of them. The arena frees them at the next collect().
+ * Programs still referenced elsewhere, e.g. queued at the mission control, are kept for their next load.
+ */
+void UAVNode::dropProgramCEEs()
+{
+    for (auto it = programCEEs.begin(); it != programCEEs.end();) {
+        ProgramCEEs& instance = it->second;
+        bool active = (std::find(instance.cees.begin(), instance.cees.end(), commandExecEngine) != instance.cees.end())
+                || (std::find(instance.approachCEEs.begin(), instance.approachCEEs.end(), commandExecEngine) != instance.approachCEEs.end());
+        if (instance.program.use_count() > 1 || active) {
+            ++it;
+            continue;
+        }
+        commandArena.discard(instance.cees);
+        commandArena.discard(instance.approachCEEs);
+        it = programCEEs.erase(it);
+    }
+}
+
+/**
+ * Create the CEE executing the given command, to be adopted by the arena.
+ */
+CommandExecEngine* UAVNode::createCEE(Command *command)
+{
+    if (WaypointCommand *cmd = dynamic_cast<WaypointCommand *>(command)) {
+        return new WaypointCEE(this, cmd);
+    }
+    else if (TakeoffCommand *cmd = dynamic_cast<TakeoffCommand *>(command)) {
+        return new TakeoffCEE(this, cmd);
+    }
+    else if (HoldPositionCommand *cmd = dynamic_cast<HoldPositionCommand *>(command)) {
+        return new HoldPositionCEE(this, cmd);
+    }
+    else if (ChargeCommand *cmd = dynamic_cast<ChargeCommand *>(command)) {
+        return new ChargeCEE(this, cmd);
+    }
+    else if (ExchangeCommand *cmd = dynamic_cast<ExchangeCommand *>(command)) {
+        return new ExchangeCEE(this, cmd);
+    }
+    else if (IdleCommand *cmd = dynamic_cast<IdleCommand *>(command)) {
+        return new IdleCEE(this, cmd);
+    }
+    throw cRuntimeError("UAVNode::createCEE(): invalid cast or unexpected command type.");
+}
+
+/**
+ * Predict the return flights after the CEEs of a loaded command queue.
+ */
+void UAVNode::predictReturnFlights()
+{
+    predictReturnFlights(std::vector<CommandExecEngine *>(cees.begin(), cees.end()), returnField, returnFlightIndex);
+    activeReturnField = &returnField;
+    activeReturnFlightIndex = &returnFlightIndex;
+    activeReturnFieldVersion = ChargingNodeRegistry::getInstance().getVersion();
+}
+
+/**
+ * Predict the return flights after the loaded CEEs again if charging nodes were added or removed since their prediction,
+ * the return flights would otherwise lead to charging nodes that changed or don't exist anymore.
+ * Plans based on them are invalidated (see endOfOperation(), updateMissionCycle()).
+ */
+void UAVNode::updateReturnFlights()
+{
+    if (activeReturnFieldVersion == ChargingNodeRegistry::getInstance().getVersion()) return;
+    EV_INFO << __func__ << "(): charging nodes changed, predicting return flights again." << endl;
+    if (program) {
+        predictProgramReturnFlights(getProgramCEEs(program));
+    }
+    else {
+        predictReturnFlights();
+    }
+    ceesGeneration++;
+}
+
+/**
+ * Use the return flights after the CEEs of the given program, predicted on its first load.
+ * They are only predicted again if the charging nodes changed since, the endpoints of the CEEs don't change.
+ * An approach waypoint ends at its HoldPosition command and shares its return flight.
+ */
+void UAVNode::predictProgramReturnFlights(ProgramCEEs& instance)
+{
+    long registryVersion = ChargingNodeRegistry::getInstance().getVersion();
+    if (instance.returnFieldVersion != registryVersion) {
+        predictReturnFlights(instance.cees, instance.returnField, instance.returnFlightIndex);
+        instance.returnFieldVersion = registryVersion;
+    }
+    for (size_t index = 0; index < instance.approachCEEs.size(); index++) {
+        if (instance.approachCEEs[index] != nullptr) instance.returnFlightIndex[instance.approachCEEs[index]] = index;
+    }
+    activeReturnField = &instance.returnField;
+    activeReturnFlightIndex = &instance.returnFlightIndex;
+    activeReturnFieldVersion = registryVersion;
+}
+
+/**
+ * Predict the return flights to the nearest charging node after every given CEE (and the grid around them, if enabled).
+ */
+void UAVNode::predictReturnFlights(const std::vector<CommandExecEngine *>& fromCEEs, ReturnEnergyField& field, ReturnFlightIndex& index)
+{
+    std::vector<double> endX, endY, endZ;
+    index.clear();
+    for (size_t k = 0; k < fromCEEs.size(); k++) {
+        index[fromCEEs[k]] = k;
+        endX.push_back(fromCEEs[k]->getX1());
+        endY.push_back(fromCEEs[k]->getY1());
+        endZ.push_back(fromCEEs[k]->getZ1());
+    }
+    field.predictPoints(getEnergyModel(), quantileZ, endX, endY, endZ);
+    field.buildGrid(getEnergyModel(), quantileZ, returnFieldCellSize);
+}
+
+/**
+ * Energy for the flight to the nearest charging node after the given CEE, precomputed for the loaded commands,
+ * predicted exactly for any other CEE.
+ */
+float UAVNode::energyToCNAfter(CommandExecEngine* cee)
+{
+    updateReturnFlights();
+    auto it = activeReturnFlightIndex->find(cee);
+    if (it != activeReturnFlightIndex->end()) {
+        return activeReturnField->getPoint(it->second).energy;
+    }
+    return predictEnergyToNearestCN(cee->getX1(), cee->getY1(), cee->getZ1());
+}
+
+/**
+ * Predict the duration of a direct flight from the current position to the given coordinates.
+ * Neither the CEE queue nor any other state of the node is touched.
+ *
+ * @return Time needed for the flight, in [s]
+ */
+double UAVNode::estimateFlightTime(double toX, double toY, double toZ) const
+{
+    return getEnergyModel().predictMovement(toX - x, toY - y, toZ - z, quantileZ).duration;
 }
 
 /**
@@ -538,36 +812,68 @@ double UAVNode::estimateCommandsDuration()
     double fromX = this->getX();
     double fromY = this->getY();
     double fromZ = this->getZ();
+    LegBatch batch;
+    batch.reserve(cees.size());
     for (auto it = cees.begin(); it != cees.end(); ++it) {
         CommandExecEngine *nextCEE = *it;
         nextCEE->setFromCoordinates(fromX, fromY, fromZ);
-        nextCEE->initializeCEE();
-        duration += nextCEE->getOverallDuration();
+        if (not appendLeg(nextCEE, batch)) {
+            nextCEE->prepareCEE();
+            duration += nextCEE->getOverallDuration();
+        }
         fromX = nextCEE->getX1();
         fromY = nextCEE->getY1();
         fromZ = nextCEE->getZ1();
     }
+
+    LegPredictions predictions;
+    getEnergyModel().predictLegs(batch, quantileZ, predictions);
+    for (size_t leg = 0; leg < predictions.size(); leg++) {
+        duration += predictions.duration[leg];
+    }
     return duration;
 }
 
-#define IDX_FUTURE_CMDS 0
-#define IDX_CMD_ENERGY 1
-#define IDX_RETURN_ENERGY 2
-#define IDX_CMD_DURATION 3
-
 #define HEURISTIC_LATEST_OPPOTUNITY 0
 #define HEURISTIC_SHORTEST_RETURN 1
 #define HEURISTIC_BIOBJECTIVE 2
 
+/**
+ * Replacement planning after a completed command, see predictEndOfOperation().
+ * In lazy mode (replacementLeadTime > 0) the last plan is kept as long as its replacement is more than
+ * replacementLeadTime ahead and the CEEs did not change (other than by executing them), no ReplacementData is sent then.
+ *
+ * @return ReplacementData for the last point of replacement
+ * @return 'nullptr' if no end of operation is predictable or the last plan is still current
+ */
+ReplacementData* UAVNode::endOfOperation()
+{
+    updateReturnFlights();
+    if (replacementLeadTime > 0 && plannedCEEsGeneration == ceesGeneration && plannedReplacementTime >= 0
+            && simTime() + replacementLeadTime < plannedReplacementTime) {
+        replacementRecomputationsSkipped++;
+        EV_DEBUG << __func__ << "(): replacement at " << plannedReplacementTime << " still ahead, keeping plan." << endl;
+        return nullptr;
+    }
+
+    ReplacementData *result = predictEndOfOperation();
+    replacementRecomputations++;
+    plannedCEEsGeneration = ceesGeneration;
+    plannedReplacementTime = (result != nullptr) ? result->timeOfReplacement : SimTime(-1);
+    return result;
+}
+
 /**
  * Iterates over all future CEEs and predicts their consumptions.
  * The consumption plus the needed energy to go back to a charging station are then compared against the remaining battery capacity.
  * Result of the calculation is the feasible amount of commands and the place of last possible replacement.
+ * For a repeating mission the cycle predictions are cached over calls (see updateMissionCycle()),
+ * cycles feasible as a whole are skipped and only the last ones before depletion are scanned command by command.
  *
  * @return ReplacementData for the last point of replacement
  * @return 'nullptr' if a command that can't be estimated (CHARGE or EXCHANGE) is enqueued before depletion
  */
-ReplacementData* UAVNode::endOfOperation()
+ReplacementData* UAVNode::predictEndOfOperation()
 {
     float energySum = 0;
     int nextCommands = 0;
@@ -585,51 +891,82 @@ ReplacementData* UAVNode::endOfOperation()
     ASSERT(replacementMethod >= 0 && replacementMethod <= 2);
     ASSERT(weightedSumWeight >= 0 && weightedSumWeight <= 1);
 
-    // Iterates through all feasible future commands and build table of predictions
-
-    /**
-     * vector of vectors of {0: number of future commands,
-     *                       1: predicted commands energy,
-     *                       2: predicted return energy,
-     *                       3: predicted commands duration}
-     * element 0 initialized with 0s
-     */
-    std::vector<std::vector<float>> nextCEEsMatrix;
-    //nextCEEsMatrix.push_back(std::vector<float> { 0.0, 0.0, FLT_MAX, 0.0 });
-
-    double tempFromX = x;
-    double tempFromY = y;
-    double tempFromZ = z;
+    // Iterates through all feasible future commands and build table of predictions (see FeasibleCommand)
+    nextCEEsMatrix.clear();
 
-    // Preliminary max feasible and energy prediction
-    while (not maxCommandsFeasibleReached) {
-        CommandExecEngine *nextCEE = cees.at(nextCommands % cees.size());
+    // The scan ends before the first CEE that can't be predicted. If there is none, cees is one repeating mission cycle.
+    size_t predictableCEEs = 0;
+    while (predictableCEEs < cees.size() && isPredictable(cees.at(predictableCEEs))) {
+        predictableCEEs++;
+    }
+    bool repeating = (predictableCEEs == cees.size());
+
+    // First pass from the current position. For a mission cycle only the first leg differs from the cached cycle predictions.
+    size_t cycleOffset = 0;
+    if (repeating) {
+        cycleOffset = updateMissionCycle();
+        predictCEESequence(1, x, y, z, firstPassPredictions);
+        for (size_t k = 1; k < cees.size(); k++) {
+            size_t idx = (cycleOffset + k) % cees.size();
+            firstPassPredictions.energy.push_back(missionCycle.predictions.energy[idx]);
+            firstPassPredictions.duration.push_back(missionCycle.predictions.duration[idx]);
+            firstPassPredictions.returnEnergy.push_back(missionCycle.predictions.returnEnergy[idx]);
+        }
+    }
+    else {
+        predictCEESequence(predictableCEEs, x, y, z, firstPassPredictions);
+    }
 
-        nextCEE->setFromCoordinates(tempFromX, tempFromY, tempFromZ);
-        tempFromX = nextCEE->getX1();
-        tempFromY = nextCEE->getY1();
-        tempFromZ = nextCEE->getZ1();
+    for (size_t k = 0; k < predictableCEEs && not maxCommandsFeasibleReached; k++) {
+        maxCommandsFeasibleReached = not appendFeasibleCommand(firstPassPredictions.energy[k], firstPassPredictions.duration[k],
+                firstPassPredictions.returnEnergy[k], energySum, nextCommands, nextCommandsDuration);
+    }
 
-        float energyForNextCEE = energyForCEE(nextCEE);
-        float energyToCNAfterCEE = energyToNearestCN(nextCEE->getX1(), nextCEE->getY1(), nextCEE->getZ1());
+    //Special case: No end foreseeable
+    if (not maxCommandsFeasibleReached && not repeating) {
+        CommandExecEngine *unpredictableCEE = cees.at(predictableCEEs);
+        //TODO remove the following if the non-mission check works
+        if (unpredictableCEE->isPartOfMission() && (unpredictableCEE->isCeeType(CeeType::CHARGE) || unpredictableCEE->isCeeType(CeeType::EXCHANGE))) {
+            throw cRuntimeError("endOfOperation(): charge or exchange command encountered");
+        }
+        if (not unpredictableCEE->isCeeType(CeeType::IDLE)) {
+            EV_WARN << __func__ << "(): non-mission command encountered before reaching depletion level. No end of operation predictable..." << endl;
+        }
+        return nullptr;
+    }
 
-        //Special case: No end foreseeable
-        if (energyForNextCEE == FLT_MAX) return nullptr;
+    if (not maxCommandsFeasibleReached) {
+        // All further cycles are identical. Skip the ones that are feasible as a whole arithmetically,
+        // the lowest remaining energy of a cycle is reached at the CEE with the highest energy consumed so far plus return energy.
+        double cycleEnergy = 0, cycleDuration = 0, cyclePeakEnergy = 0;
+        for (size_t k = 0; k < cees.size(); k++) {
+            size_t idx = (cycleOffset + k) % cees.size();
+            cycleEnergy += missionCycle.predictions.energy[idx];
+            cycleDuration += missionCycle.predictions.duration[idx];
+            cyclePeakEnergy = std::max(cyclePeakEnergy, cycleEnergy + missionCycle.predictions.returnEnergy[idx]);
+        }
+        if (cycleEnergy <= 0) {
+            EV_WARN << __func__ << "(): mission cycle without consumption. No end of operation predictable..." << endl;
+            return nullptr;
+        }
 
-        // Check if next command still feasible
-        if (energySum + energyForNextCEE + energyToCNAfterCEE < battery.getRemaining()) {
-            // prepare next while loop execution
-            nextCommands++;
-            energySum += energyForNextCEE;
-            nextCommandsDuration += nextCEE->getOverallDuration();
-            nextCEEsMatrix.push_back(std::vector<float> { (float) nextCommands, energySum, energyToCNAfterCEE, nextCommandsDuration });
-            //EV_INFO << __func__ << "(): Added to list of predictions: matrix entry " << nextCEEsMatrix.size()-1 << ", command " << nextCEE->getCeeTypeString() << nextCommands << ", energy for this CEE " << energyForNextCEE << ", energyToCNAfter " << energyToCNAfterCEE << ", nextCommandsDuration " << nextCommandsDuration << endl;
+        // Keep the last feasible cycle for the scan below: the heuristics choose from the commands of the last cycle before depletion
+        long skippedCycles = (long) floor((battery.getRemaining() - energySum - cyclePeakEnergy) / cycleEnergy) - 1;
+        if (skippedCycles > 0) {
+            energySum += skippedCycles * cycleEnergy;
+            nextCommands += (int) (skippedCycles * cees.size());
+            nextCommandsDuration += skippedCycles * cycleDuration;
         }
-        else {
-            // next command not feasible
-            maxCommandsFeasibleReached = true;
+
+        while (not maxCommandsFeasibleReached) {
+            for (size_t k = 0; k < cees.size() && not maxCommandsFeasibleReached; k++) {
+                size_t idx = (cycleOffset + k) % cees.size();
+                maxCommandsFeasibleReached = not appendFeasibleCommand(missionCycle.predictions.energy[idx], missionCycle.predictions.duration[idx],
+                        missionCycle.predictions.returnEnergy[idx], energySum, nextCommands, nextCommandsDuration);
+            }
         }
     }
+
     // At least one command has to be feasible
     if (nextCommands == 0) {
         EV_WARN << "endOfOperation(): 0 commands feasible." << endl;
@@ -639,6 +976,10 @@ ReplacementData* UAVNode::endOfOperation()
         EV_INFO << __func__ << "(): " << nextCommands << " commands feasible at most." << endl;
     }
 
+    if (not shadowCommandsVectors.empty()) {
+        recordShadowDecisions();
+    }
+
     /**
      * Replacement Heuristics
      */
@@ -648,14 +989,14 @@ ReplacementData* UAVNode::endOfOperation()
     result->nodeToReplace = this;
     CommandExecEngine *lastCEEofMission;
 
-    ASSERT((int) nextCEEsMatrix.back().at(IDX_FUTURE_CMDS) == nextCommands);
+    ASSERT(nextCEEsMatrix.back().commands == nextCommands);
     int maxCommandsFeasible = nextCommands;
 
     switch (replacementMethod) {
         case HEURISTIC_LATEST_OPPOTUNITY: {
             lastCEEofMission = cees.at((maxCommandsFeasible - 1) % cees.size());
 
-            float latestOpportunityDuration = nextCEEsMatrix.back().at(IDX_CMD_DURATION);
+            float latestOpportunityDuration = nextCEEsMatrix.back().duration;
             result->timeOfReplacement = simTime() + latestOpportunityDuration;
 
             EV_INFO << __func__ << "(): latest opportunity heuristic: " << maxCommandsFeasible << " commands feasible." << endl;
@@ -668,10 +1009,10 @@ ReplacementData* UAVNode::endOfOperation()
             float shortestReturnPathMissionDuration = 0;
 
             for (auto it = nextCEEsMatrix.cbegin(); it != nextCEEsMatrix.cend(); ++it) {
-                if (it->at(IDX_RETURN_ENERGY) <= shortestReturnPathReturnEnergy) {
-                    shortestReturnPathReturnEnergy = it->at(IDX_RETURN_ENERGY);
-                    shortestReturnPathMissionCommands = it->at(IDX_FUTURE_CMDS);
-                    shortestReturnPathMissionDuration = it->at(IDX_CMD_DURATION);
+                if (it->returnEnergy <= shortestReturnPathReturnEnergy) {
+                    shortestReturnPathReturnEnergy = it->returnEnergy;
+                    shortestReturnPathMissionCommands = it->commands;
+                    shortestReturnPathMissionDuration = it->duration;
                 }
             }
 
@@ -693,21 +1034,21 @@ ReplacementData* UAVNode::endOfOperation()
 
             for (auto it = nextCEEsMatrix.cbegin(); it != nextCEEsMatrix.cend(); ++it) {
 
-                float energyCommandsTillHere = battery.getMissing() + it->at(IDX_CMD_ENERGY);
-                float energyReturnFromHere = it->at(IDX_RETURN_ENERGY);
+                float energyCommandsTillHere = battery.getMissing() + it->energy;
+                float energyReturnFromHere = it->returnEnergy;
                 float weightedSum = weightedSumWeight * energyCommandsTillHere - (1 - weightedSumWeight) * energyReturnFromHere;
 
                 // Search bi-objective maximum
                 if (weightedSum >= bestWeightedSum) {
                     bestWeightedSum = weightedSum;
-                    bestPathMissionCommands = it->at(IDX_FUTURE_CMDS);
-                    bestPathMissionDuration = it->at(IDX_CMD_DURATION);
+                    bestPathMissionCommands = it->commands;
+                    bestPathMissionDuration = it->duration;
                 }
 
                 // Search shortest return
-                if (it->at(IDX_RETURN_ENERGY) <= shortestReturnPathReturnEnergy) {
-                    shortestReturnPathReturnEnergy = it->at(IDX_RETURN_ENERGY);
-                    shortestReturnPathMissionCommands = it->at(IDX_FUTURE_CMDS);
+                if (it->returnEnergy <= shortestReturnPathReturnEnergy) {
+                    shortestReturnPathReturnEnergy = it->returnEnergy;
+                    shortestReturnPathMissionCommands = it->commands;
                 }
             }
             ASSERT(bestPathMissionCommands != 0);
@@ -739,6 +1080,64 @@ ReplacementData* UAVNode::endOfOperation()
     return result;
 }
 
+/**
+ * Add the output vectors of one shadow decision, see recordShadowDecisions().
+ */
+void UAVNode::addShadowDecision(const std::string& name)
+{
+    shadowCommandsVectors.push_back(new cOutVector(("shadowReplacementCommands:" + name).c_str()));
+    shadowDurationVectors.push_back(new cOutVector(("shadowReplacementDuration:" + name).c_str()));
+}
+
+/**
+ * Evaluate all replacement heuristics on the table of feasible commands built by predictEndOfOperation(),
+ * the bi-objective one for every weight in shadowWeights, and record the counterfactual replacement
+ * (feasible commands until the point of replacement and the duration until then, in [s]).
+ * Only the active heuristic (replacementMethod, weightedSumWeight) is acted upon.
+ * Decisions and tie-breaking are the same as of the active heuristics.
+ */
+void UAVNode::recordShadowDecisions()
+{
+    ASSERT(not nextCEEsMatrix.empty());
+
+    // Latest opportunity
+    const FeasibleCommand& latestOpportunity = nextCEEsMatrix.back();
+    shadowCommandsVectors[0]->record(latestOpportunity.commands);
+    shadowDurationVectors[0]->record(latestOpportunity.duration);
+
+    // Shortest return, the last of equal return energies
+    size_t shortestReturnRow = 0;
+    for (size_t row = 1; row < nextCEEsMatrix.size(); row++) {
+        if (nextCEEsMatrix[row].returnEnergy <= nextCEEsMatrix[shortestReturnRow].returnEnergy) shortestReturnRow = row;
+    }
+    shadowCommandsVectors[1]->record(nextCEEsMatrix[shortestReturnRow].commands);
+    shadowDurationVectors[1]->record(nextCEEsMatrix[shortestReturnRow].duration);
+
+    // Bi-objective, one pass over the table for all weights. The inner loop over the weights is branch-free.
+    size_t weights = shadowWeights.size();
+    shadowBestSums.assign(weights, (-1) * FLT_MAX);
+    shadowBestRows.assign(weights, 0);
+    const float *weight = shadowWeights.data();
+    float *bestSum = shadowBestSums.data();
+    int *bestRow = shadowBestRows.data();
+    float missing = battery.getMissing();
+    for (size_t row = 0; row < nextCEEsMatrix.size(); row++) {
+        float energyCommandsTillHere = missing + nextCEEsMatrix[row].energy;
+        float energyReturnFromHere = nextCEEsMatrix[row].returnEnergy;
+        for (size_t w = 0; w < weights; w++) {
+            float weightedSum = weight[w] * energyCommandsTillHere - (1 - weight[w]) * energyReturnFromHere;
+            bool better = (weightedSum >= bestSum[w]);
+            bestSum[w] = better ? weightedSum : bestSum[w];
+            bestRow[w] = better ? (int) row : bestRow[w];
+        }
+    }
+    for (size_t w = 0; w < weights; w++) {
+        const FeasibleCommand& best = nextCEEsMatrix[bestRow[w]];
+        shadowCommandsVectors[2 + w]->record(best.commands);
+        shadowDurationVectors[2 + w]->record(best.duration);
+    }
+}
+
 /*
  * Determine the nearest charging node and predict the energy needed to go there.
  *
@@ -746,6 +1145,20 @@ ReplacementData* UAVNode::endOfOperation()
  * @return The current used by the UAV in [A]
  */
 float UAVNode::energyToNearestCN(double fromX, double fromY, double fromZ)
+{
+    updateReturnFlights();
+    double energy, duration;
+    if (activeReturnField->interpolate(fromX, fromY, fromZ, energy, duration)) {
+        return energy;
+    }
+    return predictEnergyToNearestCN(fromX, fromY, fromZ);
+}
+
+/**
+ * Like energyToNearestCN(), but always predicted for the actual flight instead of interpolated in the return field.
+ * To be used where an underestimation would endanger the UAV.
+ */
+float UAVNode::predictEnergyToNearestCN(double fromX, double fromY, double fromZ)
 {
 // Get consumption for flight to nearest charging node
     ChargingNode *cn = findNearestCN(fromX, fromY, fromZ);
@@ -765,25 +1178,9 @@ float UAVNode::getHoverConsumption(float duration, int fromMethod)
 {
     if (duration == 0) return 0;
 
-    float mean = HOVER_MEAN * duration / 3600;
-    float var = getVarianceFromHFormula(-1, duration);
-    float stddev = sqrt(var);
-
-    float energy = 0;
-
-    if (fromMethod == 0) {
-        cModule *network = cSimulation::getActiveSimulation()->getSystemModule();
-        do {
-            energy = omnetpp::normal(network->getRNG(0), mean, stddev);
-        } while (abs(energy - mean) > 3 * stddev || energy < mean / 3);
-    }
-    else if (fromMethod == 1) {
-        energy = mean;
-    }
-    else {
-        energy = boost::math::quantile(boost::math::normal(mean, stddev), quantile);
-    }
-    return energy / VOLTAGE * 1000;
+    double mean, variance;
+    getEnergyModel().getHoverEnergy(duration, mean, variance);
+    return drawFromMethod(mean, sqrt(variance), fromMethod, false);
 }
 
 /**
@@ -801,46 +1198,12 @@ float UAVNode::getMovementConsumption(float angle, float duration, int fromMetho
 {
     if (duration < 0.001) return 0;
 
-    float mean = 0;
-    float stddev = 0;
-    float energy = 0;
-
     ASSERT(angle >= -90.0 && angle <= +90.0);
 
-    for (u_int idx = 1; idx < NUM_ANGLES; idx++) {
-        float angle0 = ANGLE2POWER[idx - 1][0];
-        float angle1 = ANGLE2POWER[idx][0];
-
-        if ((angle0 <= angle && angle <= angle1)) {
-            float mean0 = ANGLE2POWER[idx - 1][1];
-            float mean1 = ANGLE2POWER[idx][1];
-
-            mean = mean0 + (mean1 - mean0) / (angle1 - angle0) * (angle - angle0);
-            mean = mean * duration / 3600;
-
-            float var0 = getVarianceFromHFormula(idx - 1, duration);
-            float var1 = getVarianceFromHFormula(idx, duration);
-
-            float var = var0 + (var1 - var0) / (angle1 - angle0) * (angle - angle0);
-            stddev = sqrt(var);
-            break;
-        }
-    }
-    ASSERT(mean != 0 && stddev != 0);
-
-    if (fromMethod == 0) {
-        cModule *network = cSimulation::getActiveSimulation()->getSystemModule();
-        do {
-            energy = omnetpp::normal(network->getRNG(0), mean, stddev);
-        } while (abs(energy - mean) > 3 * stddev || energy < mean / 3);
-    }
-    else if (fromMethod == 1) {
-        energy = mean;
-    }
-    else {
-        energy = boost::math::quantile(boost::math::normal(mean, stddev), quantile);
-    }
-    return energy / VOLTAGE * 1000;
+    double mean, variance;
+    getEnergyModel().getMovementEnergy(angle, duration, mean, variance);
+    ASSERT(mean != 0 && variance != 0);
+    return drawFromMethod(mean, sqrt(variance), fromMethod, false);
 }
 
 /**
@@ -853,43 +1216,52 @@ float UAVNode::getMovementConsumption(float angle, float duration, int fromMetho
  */
 float UAVNode::getSpeed(float angle, int fromMethod)
 {
-    float mean = 0;
-    float stddev = 0;
-    float speed = 0;
-
     ASSERT(angle >= -90.0 && angle <= +90.0);
 
-    for (u_int idx = 1; idx < NUM_ANGLES; idx++) {
-        float angle0 = ANGLE2SPEED[idx - 1][0];
-        float angle1 = ANGLE2SPEED[idx][0];
-
-        if ((angle0 <= angle && angle <= angle1)) {
-            float mean0 = ANGLE2SPEED[idx - 1][1];
-            float mean1 = ANGLE2SPEED[idx][1];
-            float stddev0 = ANGLE2SPEED[idx - 1][2];
-            float stddev1 = ANGLE2SPEED[idx][2];
-
-            mean = mean0 + (mean1 - mean0) / (angle1 - angle0) * (angle - angle0);
-            stddev = abs(stddev0 + (stddev1 - stddev0) / (angle1 - angle0) * (angle - angle0)) / 10;
-            break;
-        }
-    }
+    double mean, stddev;
+    getEnergyModel().getSpeed(angle, mean, stddev);
     ASSERT(mean != 0 && stddev != 0);
+    return drawFromMethod(mean, stddev, fromMethod, true);
+}
 
+/**
+ * Select a value from the normal distribution of a prediction.
+ *
+ * @param fromMethod 0: random (truncated to 3 sigma and a third of the mean, see TruncatedNormalSampler)  1: mean  2: predictionQuantile
+ * @param lowerTail Use the (1 - predictionQuantile) quantile for method 2, e.g. for pessimistic speeds
+ */
+float UAVNode::drawFromMethod(double mean, double stddev, int fromMethod, bool lowerTail)
+{
     if (fromMethod == 0) {
         cModule *network = cSimulation::getActiveSimulation()->getSystemModule();
-        do {
-            speed = omnetpp::normal(network->getRNG(0), mean, stddev);
-        } while (abs(speed - mean) > 3 * stddev || speed < mean / 3);
+        // within 3 sigma and above a third of the mean: mean + x * stddev > mean / 3  <=>  x > -2 * mean / (3 * stddev)
+        double lower = (stddev > 0) ? fmax(-2 * mean / (3 * stddev), -3) : -3;
+        return TruncatedNormalSampler::getInstance().draw(network->getRNG(0), mean, stddev, lower, 3);
     }
     else if (fromMethod == 1) {
-        speed = mean;
+        return mean;
     }
     else {
-        speed = boost::math::quantile(boost::math::normal(mean, stddev), 1 - quantile);
+        return getQuantileValue(mean, stddev, lowerTail);
     }
+}
 
-    return speed;
+/**
+ * Quantile of a normal distribution, based on the z-score of predictionQuantile cached in initialize().
+ * Falls back to the boost quantile function if the node was not initialized yet.
+ *
+ * @param mean Mean of the distribution
+ * @param stddev Standard deviation of the distribution
+ * @param lowerTail Use the (1 - predictionQuantile) quantile instead, e.g. for pessimistic speeds
+ * @return The value at the requested quantile
+ */
+float UAVNode::getQuantileValue(float mean, float stddev, bool lowerTail)
+{
+    if (std::isnan(quantileZ)) {
+        return boost::math::quantile(boost::math::normal(mean, stddev), lowerTail ? 1 - quantile : quantile);
+    }
+    // quantile(1 - p) = -quantile(p) for the symmetric standard normal
+    return mean + (lowerTail ? -quantileZ : quantileZ) * stddev;
 }
 
 void UAVNode::move()
@@ -916,58 +1288,187 @@ bool UAVNode::cmpCoord(const Command& cmd1, const Command& cmd2)
 }
 
 /**
- * Estimates/Predicts the energy consumption for the given CEE.
+ * Checks whether the consumption of the given CEE can be predicted during the end of operation estimation.
  */
-float UAVNode::energyForCEE(CommandExecEngine* cee)
+bool UAVNode::isPredictable(CommandExecEngine* cee)
 {
-    if (cee->isCeeType(CeeType::IDLE)) {
-        return FLT_MAX;
+    if (cee->isCeeType(CeeType::IDLE) || not cee->isPartOfMission()) {
+        return false;
     }
+    return not (cee->isCeeType(CeeType::CHARGE) || cee->isCeeType(CeeType::EXCHANGE));
+}
 
-    if (not cee->isPartOfMission()) {
-        EV_WARN << __func__ << "(): non-mission command encountered before reaching depletion level. No end of operation predictable..." << endl;
-        return FLT_MAX;
+/**
+ * Appends the next command to nextCEEsMatrix if its consumption plus the return flight afterwards is still covered by the battery.
+ *
+ * @return false if the command is not feasible anymore, nothing is changed then
+ */
+bool UAVNode::appendFeasibleCommand(float energyForNextCEE, float durationOfNextCEE, float energyToCNAfterCEE, float& energySum, int& nextCommands,
+        float& nextCommandsDuration)
+{
+    if (energySum + energyForNextCEE + energyToCNAfterCEE >= battery.getRemaining()) {
+        return false;
     }
-    //TODO remove the following if the above works
-    if (cee->isCeeType(CeeType::CHARGE) || cee->isCeeType(CeeType::EXCHANGE)) {
-        throw cRuntimeError("endOfOperation(): charge or exchange command encountered");
+    nextCommands++;
+    energySum += energyForNextCEE;
+    nextCommandsDuration += durationOfNextCEE;
+    nextCEEsMatrix.push_back(FeasibleCommand { (float) nextCommands, energySum, energyToCNAfterCEE, nextCommandsDuration });
+    return true;
+}
+
+/**
+ * Predicts the first 'count' CEEs of cees in one batch, as a chain of maneuvers starting at the given position.
+ * Each CEE is followed by the return flight to the nearest charging node, taken from the leg cache if known.
+ * All of them have to be predictable (see isPredictable()).
+ */
+void UAVNode::predictCEESequence(size_t count, double fromX, double fromY, double fromZ, CEEPredictions& result)
+{
+    /// Per predicted CEE: its leg in the batch and the return flight to the nearest charging node,
+    /// the latter either taken from the leg cache or predicted in the batch as well
+    struct PredictionStep {
+        size_t ceeLeg;
+        long returnLeg;
+        double returnEnergy;
+        double fromX, fromY, fromZ, cnX, cnY, cnZ;
+    };
+    std::vector<PredictionStep> steps;
+    steps.reserve(count);
+    predictionBatch.clear();
+    predictionBatch.reserve(2 * count);
+
+    for (size_t k = 0; k < count; k++) {
+        CommandExecEngine *nextCEE = cees.at(k);
+        nextCEE->setFromCoordinates(fromX, fromY, fromZ);
+        fromX = nextCEE->getX1();
+        fromY = nextCEE->getY1();
+        fromZ = nextCEE->getZ1();
+
+        auto precomputed = activeReturnFlightIndex->find(nextCEE);
+        if (precomputed != activeReturnFlightIndex->end()) {
+            PredictionStep step { predictionBatch.size(), -1, activeReturnField->getPoint(precomputed->second).energy, fromX, fromY, fromZ, 0, 0, 0 };
+            appendLeg(nextCEE, predictionBatch);
+            steps.push_back(step);
+            continue;
+        }
+
+        ChargingNode *cn = findNearestCN(fromX, fromY, fromZ);
+        if (nullptr == cn) throw omnetpp::cRuntimeError("No charging station available!");
+
+        PredictionStep step { predictionBatch.size(), -1, 0, fromX, fromY, fromZ, cn->getX(), cn->getY(), cn->getZ() };
+        appendLeg(nextCEE, predictionBatch);
+        double returnDuration;
+        if (not legCache.lookup(step.fromX, step.fromY, step.fromZ, step.cnX, step.cnY, step.cnZ, quantileZ, step.returnEnergy, returnDuration)) {
+            step.returnLeg = predictionBatch.size();
+            predictionBatch.addMovement(step.cnX - step.fromX, step.cnY - step.fromY, step.cnZ - step.fromZ);
+        }
+        steps.push_back(step);
+    }
+    getEnergyModel().predictLegs(predictionBatch, quantileZ, legPredictions);
+
+    result.energy.resize(count);
+    result.duration.resize(count);
+    result.returnEnergy.resize(count);
+    for (size_t k = 0; k < count; k++) {
+        PredictionStep& step = steps[k];
+        if (step.returnLeg >= 0) {
+            step.returnEnergy = legPredictions.energyQuantile[step.returnLeg];
+            legCache.insert(step.fromX, step.fromY, step.fromZ, step.cnX, step.cnY, step.cnZ, quantileZ, step.returnEnergy,
+                    legPredictions.duration[step.returnLeg]);
+        }
+        result.energy[k] = legPredictions.energyQuantile[step.ceeLeg];
+        result.duration[k] = legPredictions.duration[step.ceeLeg];
+        result.returnEnergy[k] = step.returnEnergy;
+    }
+}
+
+/**
+ * Keeps missionCycle in line with cees, which are rotated by one CEE per executed mission command.
+ * The cycle is only predicted again if its CEEs or the return flights changed, e.g. after a mission was loaded.
+ * In the cycle every CEE starts where the previous one ends, the first one where the last one ends.
+ * All CEEs have to be predictable (see isPredictable()).
+ *
+ * @return Index of cees.front() in missionCycle
+ */
+size_t UAVNode::updateMissionCycle()
+{
+    size_t count = cees.size();
+    if (missionCycle.cees.size() == count && missionCycle.returnFieldVersion == activeReturnFieldVersion) {
+        size_t offset = std::find(missionCycle.cees.begin(), missionCycle.cees.end(), cees.front()) - missionCycle.cees.begin();
+        bool rotated = (offset < count);
+        for (size_t k = 1; rotated && k < count; k++) {
+            rotated = (cees.at(k) == missionCycle.cees[(offset + k) % count]);
+        }
+        if (rotated) return offset;
+    }
+
+    CommandExecEngine *lastCEE = cees.back();
+    missionCycle.cees.assign(cees.begin(), cees.end());
+    missionCycle.returnFieldVersion = activeReturnFieldVersion;
+    predictCEESequence(count, lastCEE->getX1(), lastCEE->getY1(), lastCEE->getZ1(), missionCycle.predictions);
+    return 0;
+}
+
+/**
+ * Appends the maneuver of the given CEE to a batch of legs for the energy model, based on the CEE's from and to coordinates.
+ *
+ * @return false if the CEE is no flight maneuver with determined duration, nothing is appended then
+ */
+bool UAVNode::appendLeg(CommandExecEngine* cee, LegBatch& batch)
+{
+    switch (cee->getCeeType()) {
+        case CeeType::WAYPOINT:
+            batch.addMovement(cee->getX1() - cee->getX0(), cee->getY1() - cee->getY0(), cee->getZ1() - cee->getZ0());
+            return true;
+        case CeeType::TAKEOFF:
+            batch.addMovement(0, 0, cee->getZ1() - cee->getZ0());
+            return true;
+        case CeeType::HOLDPOSITION:
+            batch.addHold(cee->getOverallDuration());
+            return true;
+        default:
+            return false;
     }
+}
 
-    // Get consumption for next command
-    //cee->setFromCoordinates(cee->getX0(), cee->getY0(), cee->getZ0());
-    //cee->setToCoordinates(cee->getX1(), cee->getY1(), cee->getZ1());
-    cee->initializeCEE();
-    return cee->predictFullConsumptionQuantile();
+/**
+ * Predicts energy consumption and duration for a waypoint command
+ * from the given coordinate (i.e. fromX, fromY, fromZ)
+ * to the given coordinate (i.e. toX, toY, toZ).
+ * Results are kept in the leg cache, as the same legs (e.g. to the nearest charging node) are predicted over and over.
+ */
+void UAVNode::predictWaypointLeg(double fromX, double fromY, double fromZ, double toX, double toY, double toZ, double& energy, double& duration)
+{
+    if (legCache.lookup(fromX, fromY, fromZ, toX, toY, toZ, quantileZ, energy, duration)) {
+        return;
+    }
+    LegPrediction prediction = getEnergyModel().predictMovement(toX - fromX, toY - fromY, toZ - fromZ, quantileZ);
+    energy = prediction.energyQuantile;
+    duration = prediction.duration;
+    legCache.insert(fromX, fromY, fromZ, toX, toY, toZ, quantileZ, energy, duration);
 }
 
 /**
  * Estimates/Predicts the energy consumption for a waypoint command
  * from the given coordinate (i.e. fromX, fromY, fromZ)
- * to the given coordinate (i.e. toX, toY, toZ). The fakeNode is required but not altered nor read.
+ * to the given coordinate (i.e. toX, toY, toZ).
  */
 float UAVNode::estimateEnergy(double fromX, double fromY, double fromZ, double toX, double toY, double toZ)
 {
-    WaypointCommand estimateCommand(toX, toY, toZ);
-    WaypointCEE estimateCEE(this, &estimateCommand);
-    estimateCEE.setFromCoordinates(fromX, fromY, fromZ);
-    estimateCEE.setPartOfMission(false);
-    estimateCEE.initializeCEE();
-    return estimateCEE.predictFullConsumptionQuantile();
+    double energy, duration;
+    predictWaypointLeg(fromX, fromY, fromZ, toX, toY, toZ, energy, duration);
+    return energy;
 }
 
 /**
  * Estimates/Predicts the time needed for a waypoint command
  * from the given coordinate (i.e. fromX, fromY, fromZ)
- * to the given coordinate (i.e. toX, toY, toZ). The fakeNode is required but not altered nor read.
+ * to the given coordinate (i.e. toX, toY, toZ).
  */
 double UAVNode::estimateDuration(double fromX, double fromY, double fromZ, double toX, double toY, double toZ)
 {
-    WaypointCommand estimateCommand(toX, toY, toZ);
-    WaypointCEE estimateCEE(this, &estimateCommand);
-    estimateCEE.setFromCoordinates(fromX, fromY, fromZ);
-    estimateCEE.setPartOfMission(false);
-    estimateCEE.initializeCEE();
-    return estimateCEE.getOverallDuration();
+    double energy, duration;
+    predictWaypointLeg(fromX, fromY, fromZ, toX, toY, toZ, energy, duration);
+    return duration;
 }
 
 #endif // WITH_OSG
@@ -18,12 +18,17 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include <omnetpp.h>
 #include "MobileNode.h"
 #include "msgs/MissionMsg_m.h"
 #include "msgs/ExchangeCompletedMsg_m.h"
 #include <boost/math/distributions/normal.hpp>
 #include "UAVSoloEmpiricData.h"
+#include "EnergyModel.h"
+#include "LegPredictionCache.h"
+#include "ReturnEnergyField.h"
+#include "TruncatedNormalSampler.h"
 
 using namespace omnetpp;
 
@@ -44,10 +49,22 @@ public:
     UAVNode();
     virtual ~UAVNode();
     virtual void loadCommands(CommandQueue commands, bool isMission = true) override;
+    virtual void loadProgram(const MissionProgramHandle& program, size_t programCounter, bool programWrapped) override;
+    virtual void clearCommands() override;
     virtual double estimateCommandsDuration();
+    double estimateFlightTime(double toX, double toY, double toZ) const;
     float getHoverConsumption(float duration, int fromMethod = 0);
     float getMovementConsumption(float angle, float duration, int fromMethod = 0);
     float getSpeed(float angle, int fromMethod = 1);
+    const EnergyModel& getEnergyModel() const
+    {
+        ASSERT(energyModel);
+        return *energyModel;
+    }
+    double getQuantileZ() const
+    {
+        return quantileZ;
+    }
 
     //TODO part of hack111 to make the replacing node known to the Exchange command
     GenericNode* replacingNode = nullptr;
@@ -69,7 +86,9 @@ protected:
     virtual double nextNeededUpdate() override;
     virtual void collectStatistics() override;
     virtual ReplacementData* endOfOperation() override;
+    ReplacementData* predictEndOfOperation();
     virtual float energyToNearestCN(double fromX, double fromY, double fromZ) override;
+    float predictEnergyToNearestCN(double fromX, double fromY, double fromZ);
 
     bool exchangeAfterCurrentCommand = false;
 
@@ -81,14 +100,116 @@ protected:
 private:
     bool cmpCoord(const Command& cmd, const double X, const double Y, const double Z);
     bool cmpCoord(const Command& cmd1, const Command& cmd2);
-    float energyForCEE(CommandExecEngine* cee);
+    bool isPredictable(CommandExecEngine* cee);
+    bool appendLeg(CommandExecEngine* cee, LegBatch& batch);
     float estimateEnergy(double fromX, double fromY, double fromZ, double toX, double toY, double toZ);
     double estimateDuration(double fromX, double fromY, double fromZ, double toX, double toY, double toZ);
+    void predictWaypointLeg(double fromX, double fromY, double fromZ, double toX, double toY, double toZ, double& energy, double& duration);
+
+    /**
+     * Per CEE: consumption [mAh] and duration [s] of its maneuver, consumption [mAh] of the return flight to the nearest charging node afterwards
+     */
+    struct CEEPredictions {
+        std::vector<double> energy;
+        std::vector<double> duration;
+        std::vector<double> returnEnergy;
+    };
+    /**
+     * Predictions of the repeating mission cycle in cees, kept over endOfOperation() calls,
+     * returnFieldVersion: registry version of the return flights they were predicted with
+     */
+    struct MissionCycle {
+        std::vector<CommandExecEngine *> cees;
+        CEEPredictions predictions;
+        long returnFieldVersion = -1;
+    };
+    /**
+     * One feasible future command as determined by endOfOperation(), accumulated over all commands up to this one
+     */
+    struct FeasibleCommand {
+        float commands;
+        float energy;
+        float returnEnergy;
+        float duration;
+    };
+    MissionCycle missionCycle;
+    CEEPredictions firstPassPredictions;
+    std::vector<FeasibleCommand> nextCEEsMatrix;
+    LegBatch predictionBatch;
+    LegPredictions legPredictions;
+    void predictCEESequence(size_t count, double fromX, double fromY, double fromZ, CEEPredictions& result);
+    size_t updateMissionCycle();
+    bool appendFeasibleCommand(float energyForNextCEE, float durationOfNextCEE, float energyToCNAfterCEE, float& energySum, int& nextCommands,
+            float& nextCommandsDuration);
+    LegPredictionCache legCache;
+    /// Index into the points of a ReturnEnergyField by CEE
+    typedef std::unordered_map<const CommandExecEngine *, size_t> ReturnFlightIndex;
+    /// Return flights after the CEEs of loaded command queues (loadCommands())
+    ReturnEnergyField returnField;
+    ReturnFlightIndex returnFlightIndex;
+    /// Return flights after the loaded CEEs: the ones above or those of the loaded program (see ProgramCEEs)
+    const ReturnEnergyField *activeReturnField = &returnField;
+    const ReturnFlightIndex *activeReturnFlightIndex = &returnFlightIndex;
+    /// Version of the ChargingNodeRegistry the active return flights were predicted with
+    long activeReturnFieldVersion = -1;
+    double returnFieldCellSize = 0;
+    void updateReturnFlights();
+    void predictReturnFlights();
+    void predictReturnFlights(const std::vector<CommandExecEngine *>& fromCEEs, ReturnEnergyField& field, ReturnFlightIndex& index);
+    float energyToCNAfter(CommandExecEngine* cee);
+    /// Energy and speed model, shared by all nodes using the same model file
+    std::shared_ptr<const EnergyModel> energyModel;
+    float getQuantileValue(float mean, float stddev, bool lowerTail);
+    float drawFromMethod(double mean, double stddev, int fromMethod, bool lowerTail);
     float quantile = 0.95;
+    double quantileZ = NAN;
+    /// Lazy replacement planning (replacementLeadTime > 0): generation of cees and replacement time of the last plan, -1 if none
+    simtime_t replacementLeadTime = 0;
+    long ceesGeneration = 0;
+    long plannedCEEsGeneration = -1;
+    simtime_t plannedReplacementTime = -1;
+    long replacementRecomputations = 0;
+    long replacementRecomputationsSkipped = 0;
+    /// Shadow decisions (shadowDecisions): per table row the best weighted sum so far of every weight in shadowWeights,
+    /// output vectors in the order latest opportunity, shortest return, bi-objective per weight
+    std::vector<float> shadowWeights;
+    std::vector<float> shadowBestSums;
+    std::vector<int> shadowBestRows;
+    std::vector<cOutVector *> shadowCommandsVectors;
+    std::vector<cOutVector *> shadowDurationVectors;
+    void addShadowDecision(const std::string& name);
+    void recordShadowDecisions();
+    /**
+     * CEEs of a mission program, instantiated once per node (retained by the arena) and reused whenever the program is (re)loaded,
+     * dropped once the program is neither loaded nor referenced outside of this node (see dropProgramCEEs()).
+     * approachCEEs: per program index the waypoint to a HoldPosition command the program is loaded at, created on demand.
+     * returnField: return flights after all CEEs of the program, predicted with the registry at returnFieldVersion.
+     */
+    struct ProgramCEEs {
+        MissionProgramHandle program;
+        std::vector<CommandExecEngine *> cees;
+        std::vector<CommandExecEngine *> approachCEEs;
+        ReturnEnergyField returnField;
+        ReturnFlightIndex returnFlightIndex;
+        long returnFieldVersion = -1;
+    };
+    std::unordered_map<const MissionProgram *, ProgramCEEs> programCEEs;
+    /// Program of the current mission (nullptr if none) and whether it wrapped around since its start, see MissionProgram::getSequence()
+    MissionProgramHandle program;
+    bool programWrapped = false;
+    std::vector<size_t> programSequence;
+    CommandExecEngine* createCEE(Command *command);
+    ProgramCEEs& getProgramCEEs(const MissionProgramHandle& program);
+    void dropProgramCEEs();
+    void predictProgramReturnFlights(ProgramCEEs& instance);
+    size_t getProgramCounter() const;
+    void loadMission(const MissionProgramHandle& program, size_t programCounter, bool programWrapped);
     bool receivedMission_valid = false;
     int receivedMission_missionId;
     bool receivedMission_commandsRepeat;
-    CommandQueue receivedMission_missionCommands;
+    MissionProgramHandle receivedMission_program;
+    size_t receivedMission_programCounter = 0;
+    bool receivedMission_programWrapped = false;
 };
 
 #endif
@@ -80,33 +80,9 @@ static const float STANDBY_MEAN = 16.0; // mean power [W]
 
 static const int LAGS_SAMPLES_PER_SECOND = 10;
 
-/**
- * ACF variance inference method by Prof Hotz
- * Compare chapter 4.4. of thesis
+/*
+ * The variance of a maneuver follows from the lags by the ACF variance inference method by Prof Hotz
+ * (compare chapter 4.4. of thesis), see EnergyModel::getVariance().
  */
-inline float getVarianceFromHFormula(int angleIdx, float duration)
-{
-    float variance = 0;
-    float sum = 0;
-    u_int n = (u_int) (duration * LAGS_SAMPLES_PER_SECOND);
-
-    if (angleIdx == -1) {
-        // Hover Maneuver
-        for (u_int h = 1; h <= n-1; ++h) {
-            if (h >= NUM_HOVERLAGS) break;
-            sum += (n - h) * HOVER_LAGS[h + 1];
-        }
-        variance = n * HOVER_LAGS[0 + 1] + 2 * sum;
-    } else {
-        // Movement Maneuver
-        for (u_int h = 1; h <= n-1; ++h) {
-            if (h >= NUM_ANGLELAGS) break;
-            sum += (n - h) * ANGLE2LAGS[angleIdx][h + 1];
-        }
-        variance = n * ANGLE2LAGS[angleIdx][0 + 1] + 2 * sum;
-    }
-    variance = variance / pow(LAGS_SAMPLES_PER_SECOND, 3);
-    return abs(variance);
-}
 
 #endif /* UAVSOLOEMPIRICDATA_H_ */
@@ -0,0 +1,52 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "AssignmentSolver.h"
+
+/**
+ * Solve time of AssignmentSolver for batches of replacement requests (rows) against candidate nodes (columns)
+ * of the sizes MissionControl may see with large fleets.
+ */
+
+static const int REPETITIONS = 5;
+
+int main()
+{
+    std::mt19937 engine(2);
+    std::uniform_real_distribution<double> cost(-5000, 5000);
+    AssignmentSolver solver;
+    std::vector<long> assignment;
+    const size_t sizes[][2] = { { 10, 100 }, { 100, 200 }, { 300, 500 }, { 500, 500 }, { 500, 300 } };
+
+    printf("AssignmentSolverBench: mean of %d solves each\n", REPETITIONS);
+    for (auto& size : sizes) {
+        size_t rows = size[0], columns = size[1];
+        std::vector<double> costs(rows * columns);
+        double seconds = 0, checksum = 0;
+        for (int repetition = 0; repetition < REPETITIONS; repetition++) {
+            for (double& value : costs) value = cost(engine);
+            auto start = std::chrono::steady_clock::now();
+            checksum += solver.solve(costs, rows, columns, assignment);
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        printf("  %4zu x %-4zu %10.3f ms  (checksum %g)\n", rows, columns, seconds / REPETITIONS * 1.e3, checksum);
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "TestUtil.h"
+#include "AssignmentSolver.h"
+
+/**
+ * AssignmentSolver against exhaustive search over all assignments of small random matrices,
+ * wide, square and tall, with negative costs, ties and (as MissionControl uses them) prohibitive costs.
+ */
+
+/**
+ * Lowest total cost over all assignments of min(rows, columns) rows to distinct columns
+ */
+double bruteForce(const std::vector<double>& costs, size_t rows, size_t columns)
+{
+    double best = INFINITY;
+    if (rows <= columns) {
+        std::vector<size_t> columnOf(columns);
+        for (size_t c = 0; c < columns; c++) columnOf[c] = c;
+        do {
+            double total = 0;
+            for (size_t r = 0; r < rows; r++) total += costs[r * columns + columnOf[r]];
+            best = std::min(best, total);
+        } while (std::next_permutation(columnOf.begin(), columnOf.end()));
+    }
+    else {
+        std::vector<size_t> rowOf(rows);
+        for (size_t r = 0; r < rows; r++) rowOf[r] = r;
+        do {
+            double total = 0;
+            for (size_t c = 0; c < columns; c++) total += costs[rowOf[c] * columns + c];
+            best = std::min(best, total);
+        } while (std::next_permutation(rowOf.begin(), rowOf.end()));
+    }
+    return best;
+}
+
+/**
+ * The assignment has to be complete and consistent with the returned total
+ */
+void checkAssignment(const std::vector<double>& costs, size_t rows, size_t columns, const std::vector<long>& assignment, double total)
+{
+    CHECK(assignment.size() == rows);
+    std::vector<char> used(columns, 0);
+    size_t assigned = 0;
+    double sum = 0;
+    for (size_t r = 0; r < rows && r < assignment.size(); r++) {
+        long c = assignment[r];
+        if (c < 0) continue;
+        CHECK(c < (long) columns);
+        CHECK(!used[c]);
+        used[c] = 1;
+        assigned++;
+        sum += costs[r * columns + c];
+    }
+    CHECK(assigned == std::min(rows, columns));
+    CHECK_NEAR(sum, total, 1.e-9 * fabs(total) + 1.e-9);
+}
+
+int main()
+{
+    std::mt19937 engine(1);
+    AssignmentSolver solver;
+    std::vector<long> assignment;
+
+    for (int matrix = 0; matrix < 3000; matrix++) {
+        size_t rows = 1 + engine() % 6;
+        size_t columns = 1 + engine() % 6;
+        std::vector<double> costs(rows * columns);
+        for (double& cost : costs) {
+            // small integer range for ties, some prohibitive entries
+            cost = (engine() % 10 == 0) ? 1e9 : (double) (engine() % 100) - 30;
+        }
+        double total = solver.solve(costs, rows, columns, assignment);
+        checkAssignment(costs, rows, columns, assignment, total);
+        double best = bruteForce(costs, rows, columns);
+        CHECK_NEAR(total, best, 1.e-9 * fabs(best) + 1.e-9);
+    }
+
+    // real valued costs of larger, still enumerable, square matrices
+    std::uniform_real_distribution<double> cost(-1000, 1000);
+    for (int matrix = 0; matrix < 50; matrix++) {
+        std::vector<double> costs(8 * 8);
+        for (double& value : costs) value = cost(engine);
+        double total = solver.solve(costs, 8, 8, assignment);
+        checkAssignment(costs, 8, 8, assignment, total);
+        CHECK_NEAR(total, bruteForce(costs, 8, 8), 1.e-9);
+    }
+    return testResult("AssignmentSolverTest");
+}
@@ -0,0 +1,132 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "TestUtil.h"
+#include "ChargingNodeRegistry.h"
+
+/**
+ * ChargingNodeRegistry queries against a linear scan over all registered nodes.
+ * The registry only stores the node pointers, the test registers placeholders.
+ */
+
+struct Position {
+    double x, y, z;
+};
+
+static const size_t NODES = 60;
+static char placeholders[NODES];
+static Position positions[NODES];
+
+ChargingNode* node(size_t idx)
+{
+    return reinterpret_cast<ChargingNode *>(&placeholders[idx]);
+}
+
+/**
+ * The k nearest registered nodes by the sum of the absolute coordinate differences, earlier registration first on ties
+ */
+std::vector<ChargingNode *> scanNearest(const std::vector<size_t>& registered, double x, double y, double z, size_t k)
+{
+    std::vector<size_t> order(registered);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        double da = fabs(positions[a].x - x) + fabs(positions[a].y - y) + fabs(positions[a].z - z);
+        double db = fabs(positions[b].x - x) + fabs(positions[b].y - y) + fabs(positions[b].z - z);
+        return da < db;
+    });
+    std::vector<ChargingNode *> result;
+    for (size_t idx = 0; idx < order.size() && idx < k; idx++) {
+        result.push_back(node(order[idx]));
+    }
+    return result;
+}
+
+void checkQueries(ChargingNodeRegistry& registry, const std::vector<size_t>& registered, std::mt19937& engine)
+{
+    std::uniform_real_distribution<double> coordinate(-200, 1200);
+    std::vector<ChargingNode *> result;
+    for (int query = 0; query < 500; query++) {
+        double x = coordinate(engine), y = coordinate(engine), z = coordinate(engine) / 20;
+        std::vector<ChargingNode *> expected = scanNearest(registered, x, y, z, 5);
+        CHECK(registry.findNearest(x, y, z) == expected.front());
+        registry.findNearest(x, y, z, 5, result);
+        CHECK(result == expected);
+    }
+}
+
+int main()
+{
+    ChargingNodeRegistry& registry = ChargingNodeRegistry::getInstance();
+    std::mt19937 engine(1);
+    std::uniform_real_distribution<double> coordinate(0, 1000);
+
+    CHECK(registry.findNearest(0, 0, 0) == nullptr);
+
+    // nodes on a coarse raster produce distance ties
+    std::vector<size_t> registered;
+    for (size_t idx = 0; idx < NODES; idx++) {
+        positions[idx] = { round(coordinate(engine) / 100) * 100, round(coordinate(engine) / 100) * 100, 0 };
+        registry.add(node(idx), positions[idx].x, positions[idx].y, positions[idx].z);
+        registered.push_back(idx);
+    }
+    CHECK(registry.size() == NODES);
+    checkQueries(registry, registered, engine);
+
+    // removals invalidate the grid and change the version
+    long version = registry.getVersion();
+    for (size_t idx = 0; idx < NODES; idx += 3) {
+        registry.remove(node(idx));
+        registered.erase(std::find(registered.begin(), registered.end(), idx));
+    }
+    CHECK(registry.size() == registered.size());
+    CHECK(registry.getVersion() > version);
+    version = registry.getVersion();
+    registry.remove(node(0));
+    CHECK(registry.getVersion() == version);
+    checkQueries(registry, registered, engine);
+
+    // all nodes on one spot
+    for (size_t idx : registered) {
+        registry.remove(node(idx));
+    }
+    registered.clear();
+    for (size_t idx = 0; idx < 4; idx++) {
+        positions[idx] = { 50, 50, 10 };
+        registry.add(node(idx), 50, 50, 10);
+        registered.push_back(idx);
+    }
+    checkQueries(registry, registered, engine);
+
+    // lowest energy against single predictions
+    EnergyModel model(EnergyModelData::fromEmpiricData());
+    for (int query = 0; query < 100; query++) {
+        double x = coordinate(engine), y = coordinate(engine), z = coordinate(engine) / 10;
+        ChargingNode *expected = nullptr;
+        double lowest = INFINITY;
+        for (size_t idx : registered) {
+            double energy = model.predictMovement(positions[idx].x - x, positions[idx].y - y, positions[idx].z - z, 1.645).energyQuantile;
+            if (energy < lowest) {
+                lowest = energy;
+                expected = node(idx);
+            }
+        }
+        CHECK(registry.findLowestEnergy(model, 1.645, x, y, z) == expected);
+    }
+    return testResult("ChargingNodeRegistryTest");
+}
@@ -0,0 +1,78 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include <omnetpp.h>
+#include "EnergyModel.h"
+
+/**
+ * Throughput of the leg prediction of EnergyModel: one predictMovement() call per leg (as the CEEs do),
+ * the batched scalar implementation of predictLegs() and its AVX2 kernel.
+ */
+
+static const int LEGS = 100000;
+static const int REPETITIONS = 50;
+static const double QUANTILE_Z = 1.6448536;
+
+template<typename F>
+void run(const char *name, F predict)
+{
+    double checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int repetition = 0; repetition < REPETITIONS; repetition++) {
+        checksum += predict();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("  %-28s %8.2f ns/leg  (checksum %g)\n", name, seconds / ((double) LEGS * REPETITIONS) * 1.e9, checksum);
+}
+
+int main()
+{
+    EnergyModel model(EnergyModelData::fromEmpiricData());
+    std::mt19937 engine(3);
+    std::uniform_real_distribution<double> horizontal(-1000, 1000);
+    std::uniform_real_distribution<double> vertical(-100, 100);
+    LegBatch batch;
+    for (int leg = 0; leg < LEGS; leg++) {
+        batch.addMovement(horizontal(engine), horizontal(engine), vertical(engine));
+    }
+    LegPredictions predictions;
+
+    printf("EnergyModelBench: %d legs, %d repetitions\n", LEGS, REPETITIONS);
+    run("predictMovement() per leg", [&]() {
+        double sum = 0;
+        for (size_t leg = 0; leg < batch.size(); leg++) {
+            sum += model.predictMovement(batch.dx[leg], batch.dy[leg], batch.dz[leg], QUANTILE_Z).energyQuantile;
+        }
+        return sum;
+    });
+    run("predictLegs(), scalar", [&]() {
+        model.predictLegs(batch, QUANTILE_Z, predictions, false);
+        return predictions.energyQuantile[0];
+    });
+    if (EnergyModel::hasVectorKernel()) {
+        run("predictLegs(), AVX2", [&]() {
+            model.predictLegs(batch, QUANTILE_Z, predictions);
+            return predictions.energyQuantile[0];
+        });
+    }
+    else {
+        printf("  AVX2 kernel not available on this target or CPU\n");
+    }
+    return 0;
+}
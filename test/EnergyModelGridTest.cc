@@ -0,0 +1,101 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <cmath>
+#include <vector>
+
+#include "TestUtil.h"
+#include "EnergyModel.h"
+
+/**
+ * Accuracy of the fine angle grid of EnergyModel: speed and consumption at any climb angle have to match
+ * the piecewise linear interpolation between the measured angles of EnergyModelData,
+ * independently of the grid resolution.
+ */
+
+/// Relative tolerance, the grid may only differ by rounding
+static const double TOLERANCE = 1.e-9;
+
+/**
+ * Variance [mAh^2] of a maneuver of the given number of samples in one measured row, as the plain H-formula loop
+ */
+double rowVariance(const EnergyModelData& data, const std::vector<double>& lags, int samples)
+{
+    double sum = 0;
+    for (int h = 1; h < samples && h < (int) lags.size(); h++) {
+        sum += (double) (samples - h) * lags[h];
+    }
+    double variance = fabs(samples * lags[0] + 2 * sum) / pow(data.lagSamplesPerSecond, 3);
+    return variance * (1000 / data.voltage) * (1000 / data.voltage);
+}
+
+/**
+ * Reference prediction: interpolate between the two measured rows around the angle
+ */
+void reference(const EnergyModelData& data, double angle, double duration, double& speed, double& mean, double& variance)
+{
+    size_t row = 0;
+    while (row + 2 < data.angle.size() && angle >= data.angle[row + 1]) {
+        row++;
+    }
+    double t = (angle - data.angle[row]) / (data.angle[row + 1] - data.angle[row]);
+    speed = data.speedMean[row] + (data.speedMean[row + 1] - data.speedMean[row]) * t;
+    double power = data.power[row] + (data.power[row + 1] - data.power[row]) * t;
+    mean = power * duration / 3600 * (1000 / data.voltage);
+    int samples = std::max(1, (int) (duration * data.lagSamplesPerSecond));
+    double variance0 = rowVariance(data, data.lags[row], samples);
+    variance = variance0 + (rowVariance(data, data.lags[row + 1], samples) - variance0) * t;
+}
+
+void checkModel(const EnergyModelData& data, double angleResolution)
+{
+    EnergyModel model(data, angleResolution);
+    const double durations[] = { 0.05, 0.95, 3.05, 10, 100, 1000 };
+
+    // a sweep across the angle range plus both sides of every measured angle
+    std::vector<double> angles;
+    for (double angle = -90; angle <= 90; angle += 0.0137) {
+        angles.push_back(angle);
+    }
+    for (double measured : data.angle) {
+        angles.push_back(measured);
+        angles.push_back(measured - 1.e-7);
+        angles.push_back(measured + 1.e-7);
+    }
+
+    for (double angle : angles) {
+        angle = fmin(fmax(angle, -90.), 90.);
+        double speed, speedDeviation, refSpeed, mean, variance, refMean, refVariance;
+        model.getSpeed(angle, speed, speedDeviation);
+        reference(data, angle, 1, refSpeed, refMean, refVariance);
+        CHECK_NEAR(speed, refSpeed, TOLERANCE * refSpeed);
+        for (double duration : durations) {
+            model.getMovementEnergy(angle, duration, mean, variance);
+            reference(data, angle, duration, refSpeed, refMean, refVariance);
+            CHECK_NEAR(mean, refMean, TOLERANCE * refMean);
+            CHECK_NEAR(variance, refVariance, TOLERANCE * refVariance);
+        }
+    }
+}
+
+int main()
+{
+    EnergyModelData data = EnergyModelData::fromEmpiricData();
+    // the measured angles are not multiples of any of these resolutions, 180° is a single step
+    for (double angleResolution : { 0.25, 0.3, 1.0, 2.5, 180.0 }) {
+        checkModel(data, angleResolution);
+    }
+    return testResult("EnergyModelGridTest");
+}
@@ -0,0 +1,77 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <cmath>
+#include <random>
+
+#include "TestUtil.h"
+#include "EnergyModel.h"
+
+/**
+ * The AVX2 kernel of EnergyModel::predictLegs() against the scalar implementation, leg by leg.
+ * Without AVX2 (other target or CPU) both runs take the scalar path and the test is trivially met.
+ */
+
+/// Relative tolerance: both evaluate the same formulas, the kernel may only round differently
+static const double TOLERANCE = 1.e-12;
+
+void checkField(const std::vector<double>& actual, const std::vector<double>& expected)
+{
+    CHECK(actual.size() == expected.size());
+    for (size_t leg = 0; leg < actual.size() && leg < expected.size(); leg++) {
+        CHECK_NEAR(actual[leg], expected[leg], TOLERANCE * fabs(expected[leg]) + 1.e-15);
+    }
+}
+
+int main()
+{
+    EnergyModel model(EnergyModelData::fromEmpiricData());
+    std::mt19937 engine(7);
+    std::uniform_real_distribution<double> horizontal(-1000, 1000);
+    std::uniform_real_distribution<double> vertical(-100, 100);
+    std::uniform_real_distribution<double> seconds(0, 600);
+
+    // movements in all directions, vertical ones, holds, and legs too short to consume energy;
+    // an odd count leaves a remainder for the scalar loop
+    LegBatch batch;
+    for (int leg = 0; leg < 10001; leg++) {
+        switch (leg % 5) {
+            case 0:
+                batch.addHold(seconds(engine));
+                break;
+            case 1:
+                batch.addMovement(0, 0, vertical(engine));
+                break;
+            case 2:
+                batch.addMovement(horizontal(engine) * 1.e-6, 0, 0);
+                break;
+            default:
+                batch.addMovement(horizontal(engine), horizontal(engine), vertical(engine));
+        }
+    }
+
+    for (double quantileZ : { 0.0, 1.6448536, -1.2815516 }) {
+        LegPredictions vectorized, scalar;
+        model.predictLegs(batch, quantileZ, vectorized);
+        model.predictLegs(batch, quantileZ, scalar, false);
+        checkField(vectorized.energyMean, scalar.energyMean);
+        checkField(vectorized.energyVariance, scalar.energyVariance);
+        checkField(vectorized.energyQuantile, scalar.energyQuantile);
+        checkField(vectorized.duration, scalar.duration);
+        checkField(vectorized.durationQuantile, scalar.durationQuantile);
+    }
+    printf("EnergyModelVectorTest: AVX2 kernel %s\n", EnergyModel::hasVectorKernel() ? "used" : "not available");
+    return testResult("EnergyModelVectorTest");
+}
@@ -0,0 +1,120 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <sys/types.h>
+#include <cmath>
+#include <vector>
+
+#include "TestUtil.h"
+#include "EnergyModel.h"
+#include "UAVSoloEmpiricData.h"
+
+/**
+ * Regression test of the H-formula variance of EnergyModel (prefix sums) against the lag loop it replaced,
+ * for hover and every measured angle (where the model does not interpolate between rows).
+ */
+
+/**
+ * The former getVarianceFromHFormula(), verbatim apart from the name and fabs() instead of abs().
+ * It accumulates in float.
+ */
+inline float loopVarianceFromHFormula(int angleIdx, float duration)
+{
+    float variance = 0;
+    float sum = 0;
+    u_int n = (u_int) (duration * LAGS_SAMPLES_PER_SECOND);
+
+    if (angleIdx == -1) {
+        // Hover Maneuver
+        for (u_int h = 1; h <= n-1; ++h) {
+            if (h >= NUM_HOVERLAGS) break;
+            sum += (n - h) * HOVER_LAGS[h + 1];
+        }
+        variance = n * HOVER_LAGS[0 + 1] + 2 * sum;
+    } else {
+        // Movement Maneuver
+        for (u_int h = 1; h <= n-1; ++h) {
+            if (h >= NUM_ANGLELAGS) break;
+            sum += (n - h) * ANGLE2LAGS[angleIdx][h + 1];
+        }
+        variance = n * ANGLE2LAGS[angleIdx][0 + 1] + 2 * sum;
+    }
+    variance = variance / pow(LAGS_SAMPLES_PER_SECOND, 3);
+    return fabs(variance);
+}
+
+/**
+ * The same loop over n samples accumulated in double, the exact value the prefix sums have to reproduce
+ */
+double exactVariance(int angleIdx, u_int n)
+{
+    u_int lags = (angleIdx == -1) ? NUM_HOVERLAGS : NUM_ANGLELAGS;
+    const float *lag = (angleIdx == -1) ? HOVER_LAGS : ANGLE2LAGS[angleIdx];
+    double sum = 0;
+    for (u_int h = 1; h + 1 <= n && h < lags; ++h) {
+        sum += (double) (n - h) * lag[h + 1];
+    }
+    double variance = n * (double) lag[0 + 1] + 2 * sum;
+    return fabs(variance / pow(LAGS_SAMPLES_PER_SECOND, 3));
+}
+
+/**
+ * Variance of the model in the unit of the H-formula, i.e. without the conversion from [Wh] to [mAh]
+ */
+double modelVariance(const EnergyModel& model, int angleIdx, double duration)
+{
+    double mean, variance;
+    if (angleIdx == -1) {
+        model.getHoverEnergy(duration, mean, variance);
+    }
+    else {
+        model.getMovementEnergy(ANGLE2SPEED[angleIdx][0], duration, mean, variance);
+    }
+    double mAhPerWh = 1000 / (double) VOLTAGE;
+    return variance / (mAhPerWh * mAhPerWh);
+}
+
+int main()
+{
+    EnergyModel model(EnergyModelData::fromEmpiricData());
+
+    // durations from one sample to beyond all lags, up to a long hover
+    std::vector<float> durations;
+    for (int n = 1; n <= 100; n++) {
+        durations.push_back((n + 0.5f) / LAGS_SAMPLES_PER_SECOND);
+    }
+    for (float duration = 10; duration <= 3600; duration *= 1.1f) {
+        durations.push_back(duration);
+    }
+
+    for (int angleIdx = -1; angleIdx < (int) NUM_ANGLES; angleIdx++) {
+        for (float duration : durations) {
+            double variance = modelVariance(model, angleIdx, duration);
+            u_int n = (u_int) ((double) duration * LAGS_SAMPLES_PER_SECOND);
+            // prefix sums against the exact loop: rounding only
+            CHECK_NEAR(variance, exactVariance(angleIdx, n), 1.e-6 * exactVariance(angleIdx, n));
+            // against the float loop: its accumulation error grows with the duration
+            CHECK_NEAR(variance, loopVarianceFromHFormula(angleIdx, duration), 1.e-3 * variance + 1.e-9);
+        }
+
+        // n == 0 (shorter than one sample): the loop wrapped the unsigned (n - h), the model counts one sample
+        double oneSample = exactVariance(angleIdx, 1);
+        CHECK_NEAR(modelVariance(model, angleIdx, 0.5 / LAGS_SAMPLES_PER_SECOND), oneSample, 1.e-6 * oneSample);
+        CHECK(loopVarianceFromHFormula(angleIdx, 0.5f / LAGS_SAMPLES_PER_SECOND) > 1000 * oneSample);
+        // no maneuver, no consumption
+        CHECK(modelVariance(model, angleIdx, 0) == 0);
+    }
+    return testResult("HFormulaTest");
+}
@@ -0,0 +1,151 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+
+#include "TestUtil.h"
+#include "MissionLoader.h"
+
+/**
+ * MissionLoader: parsing of a *.track file, use of the binary cache, and re-parsing of a cache
+ * that is truncated, claims more commands than it holds, or contains garbage.
+ */
+
+static const char TRACK[] =
+        "TAKEOFF\t\t0\t\t\t0\t\t\t30\n"
+        "WAYPOINT\t50.6878\t10.9350\t20\n"
+        "HOLDPOSITION\t0\t\t\t0\t\t\t5.0\n"
+        "WAYPOINT\t50.6890\t10.9360\t40\n";
+
+std::string readFile(const std::string& fileName)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& fileName, const std::string& content)
+{
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), content.size());
+}
+
+bool sameCommands(const std::vector<MissionLoader::CompiledCommand>& a, const std::vector<MissionLoader::CompiledCommand>& b)
+{
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(MissionLoader::CompiledCommand)) == 0;
+}
+
+/**
+ * Replace the cache by the given content and compile again: the file has to be parsed and the cache rewritten
+ */
+void checkReparsed(const std::string& missionName, const std::string& cacheContent, const std::string& validCache,
+        const std::vector<MissionLoader::CompiledCommand>& expected)
+{
+    std::string cacheName = missionName + ".mcache";
+    writeFile(cacheName, cacheContent);
+    MissionLoader loader(50.687748, 10.934594, 10, true);
+    CHECK(sameCommands(loader.compile(missionName), expected));
+    CHECK(!loader.isFromCache());
+    CHECK(readFile(cacheName) == validCache);
+}
+
+int main()
+{
+    char directory[] = "/tmp/MissionLoaderTest.XXXXXX";
+    if (mkdtemp(directory) == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string missionName = std::string(directory) + "/mission.track";
+    std::string cacheName = missionName + ".mcache";
+    writeFile(missionName, TRACK);
+
+    // parse and write the cache
+    std::vector<MissionLoader::CompiledCommand> parsed;
+    {
+        MissionLoader loader(50.687748, 10.934594, 10, true);
+        parsed = loader.compile(missionName);
+        CHECK(!loader.isFromCache());
+    }
+    CHECK(parsed.size() == 4);
+    if (parsed.size() == 4) {
+        CHECK(parsed[0].type == MissionLoader::TAKEOFF && parsed[0].z == 30);
+        CHECK(parsed[1].type == MissionLoader::WAYPOINT && parsed[1].z == 20);
+        CHECK(parsed[2].type == MissionLoader::HOLD_POSITION && parsed[2].parameter == 5);
+        CHECK(parsed[2].x == parsed[1].x && parsed[2].y == parsed[1].y);
+        CHECK(parsed[3].type == MissionLoader::WAYPOINT && parsed[3].legLength > 0);
+    }
+    std::string validCache = readFile(cacheName);
+    size_t headerSize = validCache.size() - parsed.size() * sizeof(MissionLoader::CompiledCommand);
+    CHECK(validCache.size() > parsed.size() * sizeof(MissionLoader::CompiledCommand));
+
+    // no temporary file is left next to the cache
+    std::string tempName = cacheName + ".tmp" + std::to_string(getpid());
+    CHECK(access(tempName.c_str(), F_OK) != 0);
+
+    // served from the cache
+    {
+        MissionLoader loader(50.687748, 10.934594, 10, true);
+        CHECK(sameCommands(loader.compile(missionName), parsed));
+        CHECK(loader.isFromCache());
+        CommandQueue queue = loader.load(missionName);
+        CHECK(queue.size() == 4);
+        CHECK(dynamic_cast<TakeoffCommand *>(queue[0]) != nullptr);
+        CHECK(dynamic_cast<HoldPositionCommand *>(queue[2]) != nullptr && static_cast<HoldPositionCommand *>(queue[2])->getHoldSeconds() == 5);
+        for (Command *command : queue) {
+            delete command;
+        }
+    }
+
+    // a different projection invalidates the cache
+    {
+        MissionLoader loader(50.687748, 10.934594, 20, true);
+        loader.compile(missionName);
+        CHECK(!loader.isFromCache());
+        writeFile(cacheName, validCache);
+    }
+
+    // the command count is the last field of the header
+    uint64_t commandCount;
+    std::string huge = validCache;
+    commandCount = UINT64_C(1) << 60;
+    memcpy(&huge[headerSize - sizeof(commandCount)], &commandCount, sizeof(commandCount));
+    checkReparsed(missionName, huge, validCache, parsed);
+
+    std::string oneMore = validCache;
+    commandCount = parsed.size() + 1;
+    memcpy(&oneMore[headerSize - sizeof(commandCount)], &commandCount, sizeof(commandCount));
+    checkReparsed(missionName, oneMore, validCache, parsed);
+
+    checkReparsed(missionName, validCache.substr(0, validCache.size() - 1), validCache, parsed);
+    checkReparsed(missionName, validCache.substr(0, headerSize / 2), validCache, parsed);
+    checkReparsed(missionName, validCache + "x", validCache, parsed);
+
+    std::string badType = validCache;
+    int32_t type = 7;
+    memcpy(&badType[headerSize + sizeof(MissionLoader::CompiledCommand)], &type, sizeof(type));
+    checkReparsed(missionName, badType, validCache, parsed);
+
+    remove(cacheName.c_str());
+    remove(missionName.c_str());
+    rmdir(directory);
+    return testResult("MissionLoaderTest");
+}
@@ -0,0 +1,76 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef TEST_TESTUTIL_H_
+#define TEST_TESTUTIL_H_
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include <omnetpp.h>
+
+/**
+ * Minimal checks for the unit tests: a failed check is reported and counted, main() returns testResult().
+ */
+static int testFailures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        double actual_ = (actual), expected_ = (expected), tolerance_ = (tolerance); \
+        if (!(fabs(actual_ - expected_) <= tolerance_)) { \
+            fprintf(stderr, "%s:%d: CHECK_NEAR(%s, %s) failed: %.17g vs %.17g (tolerance %g)\n", __FILE__, __LINE__, #actual, #expected, \
+                    actual_, expected_, tolerance_); \
+            testFailures++; \
+        } \
+    } while (0)
+
+inline int testResult(const char *name)
+{
+    if (testFailures > 0) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, testFailures);
+        return 1;
+    }
+    printf("%s: passed\n", name);
+    return 0;
+}
+
+/**
+ * Seeded generator for the code under test, draws are reproducible between runs
+ */
+class TestRNG : public omnetpp::cRNG {
+public:
+    TestRNG(unsigned long seed) :
+            engine(seed)
+    {
+    }
+    double doubleRand() override
+    {
+        return std::uniform_real_distribution<double>(0, 1)(engine);
+    }
+
+protected:
+    std::mt19937_64 engine;
+};
+
+#endif /* TEST_TESTUTIL_H_ */
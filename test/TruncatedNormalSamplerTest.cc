@@ -0,0 +1,108 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "TestUtil.h"
+#include "TruncatedNormalSampler.h"
+
+/**
+ * Kolmogorov-Smirnov test of TruncatedNormalSampler against the exact truncated normal CDF,
+ * for the full table range, one-sided and narrow tail intervals.
+ */
+
+static const int DRAWS = 200000;
+/// Critical value of the KS statistic at the 1% level, asymptotic for large sample sizes
+static const double KS_CRITICAL = 1.628 / sqrt((double) DRAWS);
+
+/**
+ * Counts the uniform numbers drawn from it
+ */
+class CountingRNG : public TestRNG {
+public:
+    CountingRNG(unsigned long seed) :
+            TestRNG(seed)
+    {
+    }
+    double doubleRand() override
+    {
+        draws++;
+        return TestRNG::doubleRand();
+    }
+    long draws = 0;
+};
+
+double normalCdf(double x)
+{
+    return 0.5 * erfc(-x / M_SQRT2);
+}
+
+/**
+ * KS statistic D of the sorted samples against N(0,1) truncated to [lower, upper]
+ */
+double ksStatistic(const std::vector<double>& sorted, double lower, double upper)
+{
+    double cdfLower = normalCdf(lower);
+    double mass = normalCdf(upper) - cdfLower;
+    double n = sorted.size();
+    double d = 0;
+    for (size_t idx = 0; idx < sorted.size(); idx++) {
+        double cdf = (normalCdf(sorted[idx]) - cdfLower) / mass;
+        d = std::max(d, std::max(cdf - idx / n, (idx + 1) / n - cdf));
+    }
+    return d;
+}
+
+int main()
+{
+    const TruncatedNormalSampler& sampler = TruncatedNormalSampler::getInstance();
+    const double intervals[][2] = { { -3, 3 }, { -1.2, 3 }, { 0.5, 3 }, { -3, -2.5 }, { 2.5, 3 } };
+
+    for (auto& interval : intervals) {
+        CountingRNG rng(42);
+        std::vector<double> samples(DRAWS);
+        for (double& sample : samples) {
+            sample = sampler.drawStandard(&rng, interval[0], interval[1]);
+        }
+        // exactly one uniform number per draw
+        CHECK(rng.draws == DRAWS);
+
+        std::sort(samples.begin(), samples.end());
+        CHECK(samples.front() >= interval[0] && samples.back() <= interval[1]);
+        double d = ksStatistic(samples, interval[0], interval[1]);
+        if (!(d < KS_CRITICAL)) {
+            fprintf(stderr, "[%g, %g]: KS statistic %g exceeds the critical value %g\n", interval[0], interval[1], d, KS_CRITICAL);
+        }
+        CHECK(d < KS_CRITICAL);
+    }
+
+    // bounds beyond the table range are clipped, an empty interval returns the lower bound
+    CountingRNG rng(1);
+    for (int draw = 0; draw < 1000; draw++) {
+        double sample = sampler.drawStandard(&rng, -10, 10);
+        CHECK(sample >= -TruncatedNormalSampler::MAX_SIGMA && sample <= TruncatedNormalSampler::MAX_SIGMA);
+    }
+    CHECK(sampler.drawStandard(&rng, 1, 1) == 1);
+    CHECK(sampler.drawStandard(&rng, 2, 1) == 2);
+
+    // scaled draws stay within mean + [lower, upper] * stddev
+    for (int draw = 0; draw < 1000; draw++) {
+        double sample = sampler.draw(&rng, 10, 2, -1, 0.5);
+        CHECK(sample >= 8 && sample <= 11);
+    }
+    return testResult("TruncatedNormalSamplerTest");
+}
@@ -0,0 +1,93 @@
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/.
+//
+
+#ifndef TEST_SHIM_OMNETPP_H_
+#define TEST_SHIM_OMNETPP_H_
+
+/**
+ * Stand-in for <omnetpp.h> in the unit tests and benchmarks, see test/Makefile.
+ * Declares only what the tested units use: cRuntimeError, cRNG and the logging macros (which discard their output).
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <exception>
+#include <ostream>
+#include <string>
+
+namespace omnetpp {
+
+using std::endl;
+
+class cRuntimeError : public std::exception {
+public:
+    cRuntimeError(const char *format, ...)
+    {
+        char buffer[1024];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        message = buffer;
+    }
+    const char* what() const noexcept override
+    {
+        return message.c_str();
+    }
+
+private:
+    std::string message;
+};
+
+/**
+ * Random number generator interface as in OMNeT++, tests derive their own seeded generators
+ */
+class cRNG {
+public:
+    virtual ~cRNG()
+    {
+    }
+    /// uniform in [0, 1)
+    virtual double doubleRand() = 0;
+};
+
+/// Sink of the logging macros
+class cNullStream : public std::ostream {
+public:
+    cNullStream() :
+            std::ostream(nullptr)
+    {
+    }
+};
+
+inline cNullStream& nullLog()
+{
+    static cNullStream stream;
+    return stream;
+}
+
+} // namespace omnetpp
+
+#define EV omnetpp::nullLog()
+#define EV_FATAL omnetpp::nullLog()
+#define EV_ERROR omnetpp::nullLog()
+#define EV_WARN omnetpp::nullLog()
+#define EV_INFO omnetpp::nullLog()
+#define EV_DETAIL omnetpp::nullLog()
+#define EV_DEBUG omnetpp::nullLog()
+#define EV_TRACE omnetpp::nullLog()
+#define ASSERT(expr) ((void) 0)
+
+#endif /* TEST_SHIM_OMNETPP_H_ */